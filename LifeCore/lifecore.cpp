@@ -0,0 +1,2105 @@
+// LifeCore 实现，接口与编译方法见 lifecore.h
+// 内部使用 C++，对外只导出 extern "C" 函数
+
+#include "lifecore.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <variant>
+#include <type_traits>
+#include <cstring>
+#include <climits>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+using namespace std;
+
+// 架构相关的默认块宽度（可用 life_set_chunk_size 在运行时选择其他块几何）
+#ifdef ARM_OPTIMIZED
+    // 32位ARM优化配置：每行一个32位字
+    const int DEFAULT_CHUNK_SIZE = 32;
+#elif defined(X64_OPTIMIZED) || defined(ARM64_OPTIMIZED)
+    // 64位优化配置：每行一个64位字
+    const int DEFAULT_CHUNK_SIZE = 64;
+#else
+    // 通用配置
+    const int DEFAULT_CHUNK_SIZE = 32;
+#endif
+
+constexpr int log2_int(int n) { return n <= 1 ? 0 : 1 + log2_int(n / 2); }
+
+// 世界坐标范围（留出余量，邻居偏移和视口运算不会溢出）
+const int64_t WORLD_MIN = INT64_MIN / 2;
+const int64_t WORLD_MAX = INT64_MAX / 2;
+
+inline bool in_world(int64_t world_x, int64_t world_y) {
+    return world_x >= WORLD_MIN && world_x <= WORLD_MAX &&
+           world_y >= WORLD_MIN && world_y <= WORLD_MAX;
+}
+
+inline bool operator==(const LifeKey& a, const LifeKey& b) { return a.x == b.x && a.y == b.y; }
+
+// 块键哈希：两个坐标各乘一个奇数常数后取高32位（乘法哈希的高位混合最充分，相邻块分散到不同的槽）
+struct ChunkKeyHash {
+    size_t operator()(const LifeKey& key) const {
+        uint64_t h = static_cast<uint64_t>(key.x) * 0x9E3779B97F4A7C15ULL ^
+                     static_cast<uint64_t>(key.y) * 0xC2B2AE3D27D4EB4FULL;
+        return static_cast<size_t>(h >> 32);
+    }
+};
+
+// 优化邻居计算（顺序与 ChunkWorld::edge_mask 的各位对应）
+const int neighbor_offsets[8][2] = {
+    {-1, -1}, {0, -1}, {1, -1},
+    {-1,  0},           {1,  0},
+    {-1,  1}, {0,  1}, {1,  1}
+};
+
+// 字中所有活细胞的位号之和：位号第 j 位为1的位由第 j 个掩码选出，各计 2^j
+inline int64_t bit_position_sum(uint64_t word) {
+    return __builtin_popcountll(word & 0xAAAAAAAAAAAAAAAAULL)
+         + 2 * __builtin_popcountll(word & 0xCCCCCCCCCCCCCCCCULL)
+         + 4 * __builtin_popcountll(word & 0xF0F0F0F0F0F0F0F0ULL)
+         + 8 * __builtin_popcountll(word & 0xFF00FF00FF00FF00ULL)
+         + 16 * __builtin_popcountll(word & 0xFFFF0000FFFF0000ULL)
+         + 32 * __builtin_popcountll(word & 0xFFFFFFFF00000000ULL);
+}
+
+// 活细胞的包围盒与坐标和（坐标和用128位整数，远离原点的大图案也不会溢出）
+struct Extent {
+    int64_t min_x = INT64_MAX, min_y = INT64_MAX, max_x = INT64_MIN, max_y = INT64_MIN;
+    __int128 sum_x = 0, sum_y = 0;
+};
+
+// 块的占用摘要：有活细胞的行和列（第 i 位对应块内第 i 行/列），活细胞数和块内坐标和
+template <int Width>
+struct Occupancy {
+    static constexpr int MASK_WORDS = (Width + 63) / 64;
+    uint64_t rows[MASK_WORDS] = {0};
+    uint64_t cols[MASK_WORDS] = {0};
+    int32_t live = 0;
+    int32_t sum_x = 0, sum_y = 0;
+};
+
+// 块：Width x Width 个细胞按行存储，每行 ROW_WORDS 个字
+// 第 y 行第 x 个细胞位于 bitmap[y * ROW_WORDS + x / WORD_BITS] 的第 x % WORD_BITS 位，下标运算在编译期化为移位和掩码
+template <int Width, typename Word>
+struct Chunk {
+    static constexpr int SIZE = Width;
+    static constexpr int SHIFT = log2_int(Width);
+    static constexpr int WORD_BITS = sizeof(Word) * 8;
+    static constexpr int WORD_SHIFT = log2_int(WORD_BITS);
+    static constexpr int ROW_WORDS = Width / WORD_BITS;
+    static constexpr int WORDS = Width * ROW_WORDS;
+    static_assert((1 << SHIFT) == Width, "chunk width must be a power of two");
+    static_assert(ROW_WORDS >= 1 && Width % WORD_BITS == 0, "a chunk row must be a whole number of words");
+    
+    Word bitmap[WORDS] = {0}; // 位图存储
+    bool active = false;      // 演算时标记：本代需要计算
+    int live_count = 0;       // 当前块的活细胞计数
+    // 已计入世界级摘要的占用摘要；位图改变后标记为过期，查询统计时才重新计算（查询是只读接口，所以为 mutable）
+    mutable Occupancy<Width> occupancy;
+    mutable bool occupancy_stale = false;
+    
+    static constexpr int word_index(int x, int y) { return y * ROW_WORDS + (x >> WORD_SHIFT); }
+    static constexpr Word bit_mask(int x) { return static_cast<Word>(1) << (x & (WORD_BITS - 1)); }
+    
+    // 调用方保证 0 <= x, y < Width
+    inline bool get_bit(int x, int y) const {
+        return (bitmap[word_index(x, y)] & bit_mask(x)) != 0;
+    }
+    
+    inline void set_bit(int x, int y, bool value) {
+        Word& word = bitmap[word_index(x, y)];
+        Word mask = bit_mask(x);
+        if (((word & mask) != 0) == value) return;
+        
+        if (value) {
+            word |= mask;
+            live_count++;
+        } else {
+            word &= ~mask;
+            live_count--;
+        }
+    }
+};
+
+// 位切片演算一个字：above/current/below 为相邻三行，i 为字下标，i-1 和 i+1 两个字提供左右边缘位
+// 第0位是字内最左边的细胞
+template <typename Word>
+inline Word life_word(const Word* above, const Word* current, const Word* below, size_t i) {
+    constexpr int TOP = sizeof(Word) * 8 - 1;
+    
+    // 左右邻居：把相邻字的边缘位移入
+    Word a = above[i];
+    Word a_west = (a << 1) | (above[i - 1] >> TOP);
+    Word a_east = (a >> 1) | (above[i + 1] << TOP);
+    Word c = current[i];
+    Word c_west = (c << 1) | (current[i - 1] >> TOP);
+    Word c_east = (c >> 1) | (current[i + 1] << TOP);
+    Word b = below[i];
+    Word b_west = (b << 1) | (below[i - 1] >> TOP);
+    Word b_east = (b >> 1) | (below[i + 1] << TOP);
+    
+    // 位切片加法：上行三格、下行三格各得0..3，本行两格得0..2
+    Word a0 = a_west ^ a ^ a_east;
+    Word a1 = (a_west & a) | (a_east & (a_west ^ a));
+    Word b0 = b_west ^ b ^ b_east;
+    Word b1 = (b_west & b) | (b_east & (b_west ^ b));
+    Word c0 = c_west ^ c_east;
+    Word c1 = c_west & c_east;
+    
+    // 个位与进位
+    Word ones = a0 ^ b0 ^ c0;
+    Word carry = (a0 & b0) | (c0 & (a0 ^ b0));
+    // 二位：a1 + b1 + c1 + carry，任意两个为1即邻居数 >= 4
+    Word p = a1 ^ b1, q = a1 & b1;
+    Word r = c1 ^ carry, u = c1 & carry;
+    Word twos = p ^ r;
+    Word fours = q | u | (p & r);
+    
+    // 邻居数为3，或邻居数为2且当前存活
+    return twos & ~fours & (ones | c);
+}
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+// NEON：每行一个字的块几何一次处理多行（64位字2行，32位字4行）
+template <typename Word> struct RowVector;
+
+template <> struct RowVector<uint64_t> {
+    using Type = uint64x2_t;
+    static constexpr int LANES = 2;
+    static Type load(const uint64_t* p) { return vld1q_u64(p); }
+    static void store(uint64_t* p, Type v) { vst1q_u64(p, v); }
+    static Type shift_west(Type v) { return vshlq_n_u64(v, 1); }
+    static Type shift_east(Type v) { return vshrq_n_u64(v, 1); }
+    static Type bit_xor(Type a, Type b) { return veorq_u64(a, b); }
+    static Type bit_and(Type a, Type b) { return vandq_u64(a, b); }
+    static Type bit_or(Type a, Type b) { return vorrq_u64(a, b); }
+    static Type and_not(Type a, Type b) { return vbicq_u64(a, b); }
+};
+
+template <> struct RowVector<uint32_t> {
+    using Type = uint32x4_t;
+    static constexpr int LANES = 4;
+    static Type load(const uint32_t* p) { return vld1q_u32(p); }
+    static void store(uint32_t* p, Type v) { vst1q_u32(p, v); }
+    static Type shift_west(Type v) { return vshlq_n_u32(v, 1); }
+    static Type shift_east(Type v) { return vshrq_n_u32(v, 1); }
+    static Type bit_xor(Type a, Type b) { return veorq_u32(a, b); }
+    static Type bit_and(Type a, Type b) { return vandq_u32(a, b); }
+    static Type bit_or(Type a, Type b) { return vorrq_u32(a, b); }
+    static Type and_not(Type a, Type b) { return vbicq_u32(a, b); }
+};
+
+// 与 life_word 相同的规则；west_in/east_in 为每行从左右邻块移入的边缘位（已在最低/最高位上）
+template <typename Word>
+void life_rows_neon(const Word* mid, const Word* west_in, const Word* east_in, Word* out, int rows) {
+    using V = RowVector<Word>;
+    for (int y = 0; y < rows; y += V::LANES) {
+        typename V::Type a = V::load(mid + y), c = V::load(mid + y + 1), b = V::load(mid + y + 2);
+        typename V::Type a_west = V::bit_or(V::shift_west(a), V::load(west_in + y));
+        typename V::Type a_east = V::bit_or(V::shift_east(a), V::load(east_in + y));
+        typename V::Type c_west = V::bit_or(V::shift_west(c), V::load(west_in + y + 1));
+        typename V::Type c_east = V::bit_or(V::shift_east(c), V::load(east_in + y + 1));
+        typename V::Type b_west = V::bit_or(V::shift_west(b), V::load(west_in + y + 2));
+        typename V::Type b_east = V::bit_or(V::shift_east(b), V::load(east_in + y + 2));
+        
+        typename V::Type a0 = V::bit_xor(V::bit_xor(a_west, a), a_east);
+        typename V::Type a1 = V::bit_or(V::bit_and(a_west, a), V::bit_and(a_east, V::bit_xor(a_west, a)));
+        typename V::Type b0 = V::bit_xor(V::bit_xor(b_west, b), b_east);
+        typename V::Type b1 = V::bit_or(V::bit_and(b_west, b), V::bit_and(b_east, V::bit_xor(b_west, b)));
+        typename V::Type c0 = V::bit_xor(c_west, c_east);
+        typename V::Type c1 = V::bit_and(c_west, c_east);
+        
+        typename V::Type ones = V::bit_xor(V::bit_xor(a0, b0), c0);
+        typename V::Type carry = V::bit_or(V::bit_and(a0, b0), V::bit_and(c0, V::bit_xor(a0, b0)));
+        typename V::Type p = V::bit_xor(a1, b1), q = V::bit_and(a1, b1);
+        typename V::Type r = V::bit_xor(c1, carry), u = V::bit_and(c1, carry);
+        typename V::Type twos = V::bit_xor(p, r);
+        typename V::Type fours = V::bit_or(V::bit_or(q, u), V::bit_and(p, r));
+        
+        V::store(out + y, V::bit_and(V::and_not(twos, fours), V::bit_or(ones, c)));
+    }
+}
+#endif
+
+// 把 [0, count) 分给 threads 个线程处理，fn(begin, end, index)；工作量小时直接在当前线程执行
+template <typename Fn>
+void parallel_for(unsigned threads, size_t count, size_t min_per_thread, Fn&& fn) {
+    size_t parts = min<size_t>(threads, max<size_t>(1, count / max<size_t>(1, min_per_thread)));
+    if (parts <= 1) {
+        fn(0, count, 0);
+        return;
+    }
+    
+    vector<thread> workers;
+    workers.reserve(parts - 1);
+    for (size_t i = 1; i < parts; i++) {
+        workers.emplace_back(fn, count * i / parts, count * (i + 1) / parts, i);
+    }
+    fn(0, count / parts, 0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+enum LifeNeighborhood {
+    LIFE_MOORE,        // 摩尔邻域（正方形）
+    LIFE_VON_NEUMANN,  // 冯·诺依曼邻域（菱形）
+    LIFE_HEX           // 六边形邻域（正方形去掉右上和左下两角）
+};
+
+// 演算规则：邻域形状、范围和按邻居数索引的出生/存活表
+struct RuleTable {
+    LifeNeighborhood neighborhood = LIFE_MOORE;
+    int range = 1;
+    bool include_center = false;    // 邻居数是否计入细胞本身（Larger-than-Life 的 M1）
+    vector<char> birth, survive;    // 下标为邻居数
+    vector<pair<int, int>> spans;   // 第 dy + range 行的邻域在 dx 方向覆盖 [first, second]
+    bool conway = true;             // 摩尔邻域 B3/S23：使用位切片内核
+    string name = "B3/S23";
+};
+
+// 各行邻域的 dx 区间：摩尔为正方形，冯·诺依曼为菱形，六边形为去掉右上和左下两角的正方形（|dx - dy| <= R）
+static vector<pair<int, int>> neighborhood_spans(LifeNeighborhood neighborhood, int range) {
+    vector<pair<int, int>> spans;
+    for (int dy = -range; dy <= range; dy++) {
+        switch (neighborhood) {
+            case LIFE_MOORE: spans.emplace_back(-range, range); break;
+            case LIFE_VON_NEUMANN: spans.emplace_back(-(range - abs(dy)), range - abs(dy)); break;
+            case LIFE_HEX: spans.emplace_back(max(-range, dy - range), min(range, dy + range)); break;
+        }
+    }
+    return spans;
+}
+
+// 解析 "a..b" 形式的计数范围
+static bool parse_count_range(const string& text, int& low, int& high) {
+    size_t dots = text.find("..");
+    if (dots == string::npos) return false;
+    char* end;
+    low = static_cast<int>(strtol(text.c_str(), &end, 10));
+    if (end != text.c_str() + dots) return false;
+    high = static_cast<int>(strtol(text.c_str() + dots + 2, &end, 10));
+    return *end == '\0' && dots > 0 && low <= high;
+}
+
+// 解析规则字符串，成功时填好 rule（含规范化的名字）
+// B3/S23 形式：计数为单个数字，后缀 V 为冯·诺依曼邻域、H 为六边形邻域
+// Larger-than-Life 形式：R5,C0,M1,S34..58,B34..45,NM（C 只支持 0/2 两种状态，N 后为 M/N/H）
+static bool parse_rule(const char* text, RuleTable& rule) {
+    string spec(text);
+    RuleTable parsed;
+    int birth_low = 0, birth_high = -1, survive_low = 0, survive_high = -1;
+    vector<int> birth_counts, survive_counts;
+    
+    if (!spec.empty() && (spec[0] == 'R' || spec[0] == 'r')) {
+        istringstream fields(spec);
+        string field;
+        bool has_range = false, has_birth = false, has_survive = false;
+        while (getline(fields, field, ',')) {
+            if (field.size() < 2) return false;
+            char key = static_cast<char>(toupper(field[0]));
+            string value = field.substr(1);
+            char* end;
+            if (key == 'R') {
+                parsed.range = static_cast<int>(strtol(value.c_str(), &end, 10));
+                if (*end != '\0') return false;
+                has_range = true;
+            } else if (key == 'C') {
+                long states = strtol(value.c_str(), &end, 10);
+                if (*end != '\0' || (states != 0 && states != 2)) return false;
+            } else if (key == 'M') {
+                if (value != "0" && value != "1") return false;
+                parsed.include_center = (value == "1");
+            } else if (key == 'S') {
+                if (!parse_count_range(value, survive_low, survive_high)) return false;
+                has_survive = true;
+            } else if (key == 'B') {
+                if (!parse_count_range(value, birth_low, birth_high)) return false;
+                has_birth = true;
+            } else if (key == 'N') {
+                char shape = static_cast<char>(toupper(value[0]));
+                if (value.size() != 1 || (shape != 'M' && shape != 'N' && shape != 'H')) return false;
+                parsed.neighborhood = shape == 'M' ? LIFE_MOORE : shape == 'N' ? LIFE_VON_NEUMANN : LIFE_HEX;
+            } else {
+                return false;
+            }
+        }
+        if (!has_range || !has_birth || !has_survive) return false;
+        for (int n = birth_low; n <= birth_high; n++) birth_counts.push_back(n);
+        for (int n = survive_low; n <= survive_high; n++) survive_counts.push_back(n);
+    } else {
+        size_t slash = spec.find('/');
+        if (slash == string::npos || slash == 0 || slash + 1 >= spec.size()) return false;
+        string births = spec.substr(0, slash), survives = spec.substr(slash + 1);
+        if (toupper(births[0]) != 'B' || toupper(survives[0]) != 'S') return false;
+        
+        char suffix = static_cast<char>(toupper(survives.back()));
+        if (suffix == 'V' || suffix == 'H') {
+            parsed.neighborhood = suffix == 'V' ? LIFE_VON_NEUMANN : LIFE_HEX;
+            survives.pop_back();
+        }
+        for (size_t i = 1; i < births.size(); i++) {
+            if (!isdigit(static_cast<unsigned char>(births[i]))) return false;
+            birth_counts.push_back(births[i] - '0');
+        }
+        for (size_t i = 1; i < survives.size(); i++) {
+            if (!isdigit(static_cast<unsigned char>(survives[i]))) return false;
+            survive_counts.push_back(survives[i] - '0');
+        }
+    }
+    if (parsed.range < 1 || parsed.range > LIFE_MAX_RANGE) return false;
+    
+    parsed.spans = neighborhood_spans(parsed.neighborhood, parsed.range);
+    int max_count = parsed.include_center ? 0 : -1;
+    for (auto& span : parsed.spans) {
+        max_count += span.second - span.first + 1;
+    }
+    parsed.birth.assign(max_count + 1, 0);
+    parsed.survive.assign(max_count + 1, 0);
+    for (int n : birth_counts) {
+        // B0 会让无界平面的空白处全部出生
+        if (n <= 0 || n > max_count) return false;
+        parsed.birth[n] = 1;
+    }
+    for (int n : survive_counts) {
+        if (n < 0 || n > max_count) return false;
+        parsed.survive[n] = 1;
+    }
+    
+    // 规范化的名字
+    ostringstream name;
+    if (spec[0] == 'R' || spec[0] == 'r') {
+        const char shapes[] = {'M', 'N', 'H'};
+        name << "R" << parsed.range << ",C0,M" << parsed.include_center
+             << ",S" << survive_low << ".." << survive_high << ",B" << birth_low << ".." << birth_high
+             << ",N" << shapes[parsed.neighborhood];
+    } else {
+        name << "B";
+        for (int n = 0; n <= max_count; n++) if (parsed.birth[n]) name << n;
+        name << "/S";
+        for (int n = 0; n <= max_count; n++) if (parsed.survive[n]) name << n;
+        if (parsed.neighborhood == LIFE_VON_NEUMANN) name << "V";
+        if (parsed.neighborhood == LIFE_HEX) name << "H";
+    }
+    parsed.name = name.str();
+    parsed.conway = parsed.neighborhood == LIFE_MOORE && parsed.range == 1 && !parsed.include_center &&
+                    parsed.name == "B3/S23";
+    rule = move(parsed);
+    return true;
+}
+
+// 通用规则演算的临时缓冲（每个线程一份）
+struct RuleScratch {
+    vector<uint8_t> cells;
+    vector<uint32_t> prefix;
+    vector<uint32_t> sums;
+};
+
+// 通用规则演算：scratch.cells 为 rows + 2R 行、每行 cols + 2R 个字节（0/1，四周含 R 格晕圈），
+// 对中间 rows x cols 个细胞求下一代，对每个存活细胞调用 emit(x, y)
+// 邻居数用行前缀和求出：每行邻域是一段连续区间，一次减法得到该段的和，
+// 摩尔邻域再沿列滑动窗口，每格只需常数次加减，与范围 R 无关
+template <typename Emit>
+void apply_rule(const RuleTable& rule, int cols, int rows, RuleScratch& scratch, Emit&& emit) {
+    const int r = rule.range;
+    const int stride = cols + 2 * r;
+    const int padded_rows = rows + 2 * r;
+    const uint8_t* cells = scratch.cells.data();
+    
+    // prefix 第 py 行第 i 项为该行前 i 格的活细胞数
+    scratch.prefix.resize(static_cast<size_t>(padded_rows) * (stride + 1));
+    for (int py = 0; py < padded_rows; py++) {
+        uint32_t* p = &scratch.prefix[static_cast<size_t>(py) * (stride + 1)];
+        const uint8_t* row = cells + static_cast<size_t>(py) * stride;
+        p[0] = 0;
+        for (int i = 0; i < stride; i++) {
+            p[i + 1] = p[i] + row[i];
+        }
+    }
+    auto prefix_row = [&](int py) { return &scratch.prefix[static_cast<size_t>(py) * (stride + 1)]; };
+    auto next_state = [&](int x, int y, uint32_t count) {
+        bool alive = cells[static_cast<size_t>(y + r) * stride + x + r];
+        if (alive && !rule.include_center) count--;
+        if (alive ? rule.survive[count] : rule.birth[count]) emit(x, y);
+    };
+    
+    if (rule.neighborhood == LIFE_MOORE) {
+        // sums[x] 为当前 2R+1 行窗口内、以 x 为中心的 2R+1 列之和
+        scratch.sums.assign(cols, 0);
+        auto add_row = [&](int py, int sign) {
+            const uint32_t* p = prefix_row(py);
+            for (int x = 0; x < cols; x++) {
+                scratch.sums[x] += sign * static_cast<int>(p[x + 2 * r + 1] - p[x]);
+            }
+        };
+        for (int py = 0; py < 2 * r; py++) add_row(py, 1);
+        for (int y = 0; y < rows; y++) {
+            add_row(y + 2 * r, 1);
+            for (int x = 0; x < cols; x++) {
+                next_state(x, y, scratch.sums[x]);
+            }
+            add_row(y, -1);
+        }
+        return;
+    }
+    
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < cols; x++) {
+            uint32_t count = 0;
+            for (int k = 0; k <= 2 * r; k++) {
+                const uint32_t* p = prefix_row(y + k);
+                count += p[x + r + rule.spans[k].second + 1] - p[x + r + rule.spans[k].first];
+            }
+            next_state(x, y, count);
+        }
+    }
+}
+
+// 图案查找的一个朝向：height 行、每行 words 个字的位图，原点为包围盒左上角
+struct FindPattern {
+    int width = 0;
+    int height = 0;
+    int words = 0;
+    int orientation = 0;
+    int anchor = 0;  // 第0行最左边活细胞的列：匹配处该格必为活细胞，只需从活细胞出发尝试
+    vector<uint64_t> bits;
+    
+    void init(int w, int h) {
+        width = w;
+        height = h;
+        words = (w + 63) / 64;
+        bits.assign(static_cast<size_t>(words) * h, 0);
+    }
+    
+    bool get(int x, int y) const { return (bits[static_cast<size_t>(y) * words + x / 64] >> (x % 64)) & 1; }
+    void set(int x, int y) { bits[static_cast<size_t>(y) * words + x / 64] |= 1ULL << (x % 64); }
+};
+
+// 由输入位图生成8个朝向（先取活细胞包围盒；0..3 为顺时针旋转 0/90/180/270 度，4..7 为左右镜像后再旋转）
+// 对称图案中相同的朝向只保留第一个，保证每处出现只报告一次
+static vector<FindPattern> pattern_orientations(const uint64_t* bits, int width, int height) {
+    const int words = (width + 63) / 64;
+    int min_x = INT_MAX, min_y = INT_MAX, max_x = -1, max_y = -1;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (!((bits[static_cast<size_t>(y) * words + x / 64] >> (x % 64)) & 1)) continue;
+            min_x = min(min_x, x);
+            min_y = min(min_y, y);
+            max_x = max(max_x, x);
+            max_y = max(max_y, y);
+        }
+    }
+    if (max_x < 0) return {};
+    
+    FindPattern base;
+    base.init(max_x - min_x + 1, max_y - min_y + 1);
+    for (int y = 0; y < base.height; y++) {
+        for (int x = 0; x < base.width; x++) {
+            if ((bits[static_cast<size_t>(y + min_y) * words + (x + min_x) / 64] >> ((x + min_x) % 64)) & 1) base.set(x, y);
+        }
+    }
+    
+    vector<FindPattern> result;
+    for (int orientation = 0; orientation < 8; orientation++) {
+        FindPattern current = base;
+        if (orientation >= 4) {
+            FindPattern mirrored;
+            mirrored.init(current.width, current.height);
+            for (int y = 0; y < current.height; y++) {
+                for (int x = 0; x < current.width; x++) {
+                    if (current.get(x, y)) mirrored.set(current.width - 1 - x, y);
+                }
+            }
+            current = move(mirrored);
+        }
+        // 顺时针旋转90度：(x, y) -> (height - 1 - y, x)
+        for (int turn = 0; turn < orientation % 4; turn++) {
+            FindPattern rotated;
+            rotated.init(current.height, current.width);
+            for (int y = 0; y < current.height; y++) {
+                for (int x = 0; x < current.width; x++) {
+                    if (current.get(x, y)) rotated.set(current.height - 1 - y, x);
+                }
+            }
+            current = move(rotated);
+        }
+        
+        bool duplicate = any_of(result.begin(), result.end(), [&](const FindPattern& other) {
+            return other.width == current.width && other.height == current.height && other.bits == current.bits;
+        });
+        if (duplicate) continue;
+        current.orientation = orientation;
+        while (!current.get(current.anchor, 0)) current.anchor++;
+        result.push_back(move(current));
+    }
+    return result;
+}
+
+// 取位图中从第 bit 位开始的64位（调用方保证其后还有一个可读的字）
+static inline uint64_t read_bits64(const uint64_t* row, size_t bit) {
+    size_t k = bit >> 6;
+    int shift = static_cast<int>(bit & 63);
+    return shift ? (row[k] >> shift) | (row[k + 1] << (64 - shift)) : row[k];
+}
+
+// 在 cols x rows 个锚点（匹配处包围盒的左上角）上匹配一个朝向
+// buf 为 rows + height - 1 行、每行 stride 个字的位图，锚点区域最左列在每行的第 base 位
+// 64个相邻锚点为一组：图案每一格把对应行移位 base + 列号 后与入候选掩码（活细胞取原值，死细胞取反），
+// 掩码变为0时提前结束；对每个匹配调用 emit(dx, dy)（相对锚点区域左上角）
+template <typename Emit>
+static void match_rows(const FindPattern& pattern, const uint64_t* buf, size_t stride, size_t base,
+                       int cols, int rows, Emit&& emit) {
+    for (int y = 0; y < rows; y++) {
+        for (int x0 = 0; x0 < cols; x0 += 64) {
+            uint64_t candidates = cols - x0 >= 64 ? ~0ULL : (1ULL << (cols - x0)) - 1;
+            // 先检查锚点格（活细胞稀疏时大多数组在这里就被排除）
+            candidates &= read_bits64(buf + static_cast<size_t>(y) * stride, base + x0 + pattern.anchor);
+            for (int py = 0; py < pattern.height && candidates; py++) {
+                const uint64_t* row = buf + static_cast<size_t>(y + py) * stride;
+                const uint64_t* cells = &pattern.bits[static_cast<size_t>(py) * pattern.words];
+                for (int px = 0; px < pattern.width; px++) {
+                    uint64_t word = read_bits64(row, base + x0 + px);
+                    candidates &= ((cells[px / 64] >> (px % 64)) & 1) ? word : ~word;
+                }
+            }
+            while (candidates) {
+                emit(x0 + __builtin_ctzll(candidates), y);
+                candidates &= candidates - 1;
+            }
+        }
+    }
+}
+
+// 块表：块连续存放在 chunks 中，slots 为开放寻址（线性探测）哈希表，槽中保存块下标，-1 为空槽
+// 空块由 compact 成批删除后整表重建，因此不需要墓碑；插入和 compact 都会移动块，之前取得的指针随之失效
+template <typename ChunkType>
+struct ChunkTable {
+    vector<ChunkType> chunks;
+    vector<LifeKey> keys;
+    vector<int32_t> slots;
+    size_t slot_mask = 0;
+    LifeKey last_key = {0, 0};  // 最近一次命中的键，连续访问同一块时跳过哈希
+    int32_t last_index = -1;
+    
+    size_t size() const { return chunks.size(); }
+    
+    void clear() {
+        chunks.clear();
+        keys.clear();
+        slots.clear();
+        slot_mask = 0;
+        last_index = -1;
+    }
+    
+    // 不读写命中缓存，可以被多个线程同时调用
+    int32_t index_of(const LifeKey& key) const {
+        if (slots.empty()) return -1;
+        for (size_t i = ChunkKeyHash()(key) & slot_mask; ; i = (i + 1) & slot_mask) {
+            int32_t index = slots[i];
+            if (index < 0 || keys[index] == key) return index;
+        }
+    }
+    
+    const ChunkType* find(const LifeKey& key) const {
+        int32_t index = index_of(key);
+        return index >= 0 ? &chunks[index] : nullptr;
+    }
+    
+    // 带命中缓存的查找（只在单线程中使用）
+    ChunkType* lookup(const LifeKey& key) {
+        if (last_index >= 0 && last_key == key) return &chunks[last_index];
+        int32_t index = index_of(key);
+        if (index < 0) return nullptr;
+        last_key = key;
+        last_index = index;
+        return &chunks[index];
+    }
+    
+    // 获取或创建块
+    ChunkType* get(const LifeKey& key) {
+        ChunkType* chunk = lookup(key);
+        if (chunk) return chunk;
+        
+        // 装载率不超过1/2
+        if ((chunks.size() + 1) * 2 > slots.size()) {
+            rehash(max<size_t>(64, slots.size() * 2));
+        }
+        int32_t index = static_cast<int32_t>(chunks.size());
+        chunks.emplace_back();
+        keys.push_back(key);
+        insert_slot(key, index);
+        last_key = key;
+        last_index = index;
+        return &chunks.back();
+    }
+    
+    // 只保留 keep(chunk) 为 true 的块，保持原有顺序
+    template <typename Keep>
+    void compact(Keep&& keep) {
+        size_t kept = 0;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            if (!keep(chunks[i])) continue;
+            if (kept != i) {
+                chunks[kept] = chunks[i];
+                keys[kept] = keys[i];
+            }
+            kept++;
+        }
+        if (kept == chunks.size()) return;
+        
+        chunks.resize(kept);
+        keys.resize(kept);
+        rehash(slots.size());
+    }
+    
+    void rehash(size_t slot_count) {
+        slots.assign(slot_count, -1);
+        slot_mask = slot_count - 1;
+        last_index = -1;
+        for (size_t i = 0; i < keys.size(); i++) {
+            insert_slot(keys[i], static_cast<int32_t>(i));
+        }
+    }
+    
+    void insert_slot(const LifeKey& key, int32_t index) {
+        size_t i = ChunkKeyHash()(key) & slot_mask;
+        while (slots[i] >= 0) i = (i + 1) & slot_mask;
+        slots[i] = index;
+    }
+};
+
+// 无界平面：以 Width x Width 的块为单位稀疏存储
+template <int Width, typename Word>
+struct ChunkWorld {
+    using ChunkType = Chunk<Width, Word>;
+    static constexpr int SIZE = Width;
+    static constexpr int WORD_BITS = ChunkType::WORD_BITS;
+    static constexpr int ROW_WORDS = ChunkType::ROW_WORDS;
+    static constexpr int WORDS = ChunkType::WORDS;
+    // 历史记录按64位字保存块位图
+    static constexpr size_t RECORD_WORDS = sizeof(ChunkType::bitmap) / sizeof(uint64_t);
+    static_assert(sizeof(ChunkType::bitmap) % sizeof(uint64_t) == 0, "chunk bitmap must fill whole 64-bit words");
+    // 演算缓冲：块位图四周加一圈晕圈（左右各一个字，上下各一行）
+    static constexpr int PAD_STRIDE = ROW_WORDS + 2;
+    static constexpr int PAD_WORDS = PAD_STRIDE * (Width + 2);
+    
+    using OccupancyType = Occupancy<Width>;
+    static constexpr int MASK_WORDS = OccupancyType::MASK_WORDS;
+    
+    ChunkTable<ChunkType> chunks;
+    vector<Word> next;  // 各块的下一代位图
+    vector<int> next_live;
+    
+    // 世界级占用摘要：块行号 -> 该块行内第 i 行有活细胞的块数（以 {0, 块行号} 为键存在块表中），块列号同理
+    // 有活细胞的块行/块列号另存在有序集合中（只在块行/块列变空或变为非空时改动），两端就是包围盒所在的块行/块列
+    // 演算和编辑只把变化的块记入 stale，查询时才把这些块的新摘要计入，快进时不承担任何统计开销
+    struct AxisCounts {
+        int32_t counts[Width] = {0};
+        int occupied = 0;  // counts 中非零的个数
+    };
+    mutable ChunkTable<AxisCounts> row_counts, col_counts;
+    mutable std::set<int64_t> occupied_rows, occupied_cols;
+    mutable __int128 sum_x = 0, sum_y = 0;  // 所有活细胞的世界坐标和
+    mutable vector<LifeKey> stale;
+    
+    // 世界坐标 -> 块坐标（向下取整，-1..-Width 属于 -1 号块）
+    static int64_t chunk_coord(int64_t world) { return world >> ChunkType::SHIFT; }
+    
+    // 世界坐标 -> 块内坐标（始终为非负）
+    static int local_coord(int64_t world) { return static_cast<int>(world & (Width - 1)); }
+    
+    void clear() {
+        chunks.clear();
+        row_counts.clear();
+        col_counts.clear();
+        occupied_rows.clear();
+        occupied_cols.clear();
+        sum_x = sum_y = 0;
+        stale.clear();
+    }
+    
+    // 由位图计算块的占用摘要
+    static OccupancyType occupancy_of(const Word* bitmap) {
+        OccupancyType result;
+        for (int y = 0; y < Width; y++) {
+            int row_live = 0;
+            for (int k = 0; k < ROW_WORDS; k++) {
+                uint64_t word = bitmap[y * ROW_WORDS + k];
+                if (!word) continue;
+                int count = __builtin_popcountll(word);
+                int x = k * WORD_BITS;
+                row_live += count;
+                result.cols[x / 64] |= word << (x % 64);
+                result.sum_x += count * x + static_cast<int32_t>(bit_position_sum(word));
+            }
+            if (row_live) {
+                result.rows[y / 64] |= 1ULL << (y % 64);
+                result.sum_y += row_live * y;
+                result.live += row_live;
+            }
+        }
+        return result;
+    }
+    
+    // 块行/块列中各行/列的占用由 before 变为 after
+    static void update_axis(ChunkTable<AxisCounts>& axis, std::set<int64_t>& occupied, int64_t index,
+                            const uint64_t* before, const uint64_t* after) {
+        if (equal(before, before + MASK_WORDS, after)) return;
+        AxisCounts& entry = *axis.get({0, index});
+        const bool was_occupied = entry.occupied > 0;
+        for (int k = 0; k < MASK_WORDS; k++) {
+            uint64_t changed = before[k] ^ after[k];
+            while (changed) {
+                int bit = __builtin_ctzll(changed);
+                int32_t& count = entry.counts[k * 64 + bit];
+                if ((after[k] >> bit) & 1) {
+                    if (count++ == 0) entry.occupied++;
+                } else {
+                    if (--count == 0) entry.occupied--;
+                }
+                changed &= changed - 1;
+            }
+        }
+        if (was_occupied == (entry.occupied > 0)) return;
+        if (was_occupied) {
+            occupied.erase(index);
+            // 空项多于一半时成批删除
+            if (axis.size() > 2 * occupied.size() + 64) {
+                axis.compact([](const AxisCounts& counts) { return counts.occupied > 0; });
+            }
+        } else {
+            occupied.insert(index);
+        }
+    }
+    
+    // 把块的新占用摘要计入世界级摘要
+    void update_occupancy(const LifeKey& key, const ChunkType& chunk, const OccupancyType& after) const {
+        const OccupancyType& before = chunk.occupancy;
+        sum_x += static_cast<__int128>(after.live - before.live) * (key.x * Width) + (after.sum_x - before.sum_x);
+        sum_y += static_cast<__int128>(after.live - before.live) * (key.y * Width) + (after.sum_y - before.sum_y);
+        update_axis(row_counts, occupied_rows, key.y, before.rows, after.rows);
+        update_axis(col_counts, occupied_cols, key.x, before.cols, after.cols);
+        chunk.occupancy = after;
+        chunk.occupancy_stale = false;
+    }
+    
+    // 位图改变后调用
+    void mark_stale(const LifeKey& key, const ChunkType& chunk) {
+        if (chunk.occupancy_stale) return;
+        chunk.occupancy_stale = true;
+        stale.push_back(key);
+    }
+    
+    // 把过期块的新摘要计入世界级摘要（被删除或已更新的块跳过）
+    void flush_stale() const {
+        for (const LifeKey& key : stale) {
+            const ChunkType* chunk = chunks.find(key);
+            if (!chunk || !chunk->occupancy_stale) continue;
+            update_occupancy(key, *chunk, occupancy_of(chunk->bitmap));
+        }
+        stale.clear();
+    }
+    
+    // 包围盒与坐标和：先计入过期的块，再取有序集合的两端并扫描一个块宽度
+    Extent extent() const {
+        flush_stale();
+        Extent result;
+        result.sum_x = sum_x;
+        result.sum_y = sum_y;
+        if (occupied_rows.empty()) return result;
+        
+        auto first = [](const ChunkTable<AxisCounts>& axis, int64_t index) {
+            const AxisCounts* entry = axis.find({0, index});
+            int i = 0;
+            while (!entry->counts[i]) i++;
+            return index * Width + i;
+        };
+        auto last = [](const ChunkTable<AxisCounts>& axis, int64_t index) {
+            const AxisCounts* entry = axis.find({0, index});
+            int i = Width - 1;
+            while (!entry->counts[i]) i--;
+            return index * Width + i;
+        };
+        result.min_y = first(row_counts, *occupied_rows.begin());
+        result.max_y = last(row_counts, *occupied_rows.rbegin());
+        result.min_x = first(col_counts, *occupied_cols.begin());
+        result.max_x = last(col_counts, *occupied_cols.rbegin());
+        return result;
+    }
+    
+    bool peek(int64_t world_x, int64_t world_y) {
+        // 防止极端坐标值
+        if (!in_world(world_x, world_y)) return false;
+        ChunkType* chunk = chunks.lookup({chunk_coord(world_x), chunk_coord(world_y)});
+        return chunk && chunk->get_bit(local_coord(world_x), local_coord(world_y));
+    }
+    
+    // 返回活细胞数的变化，变化的块键加入 dirty
+    int set(int64_t world_x, int64_t world_y, bool alive, vector<LifeKey>& dirty) {
+        if (!in_world(world_x, world_y)) return 0;
+        LifeKey key = {chunk_coord(world_x), chunk_coord(world_y)};
+        ChunkType* chunk = alive ? chunks.get(key) : chunks.lookup(key);
+        if (!chunk) return 0;
+        
+        int before = chunk->live_count;
+        chunk->set_bit(local_coord(world_x), local_coord(world_y), alive);
+        if (chunk->live_count == before) return 0;
+        mark_stale(key, *chunk);
+        dirty.push_back(key);
+        return chunk->live_count - before;
+    }
+    
+    template <typename Fn>
+    void for_each_live(Fn&& fn) const {
+        for_each_live(0, chunks.size(), fn);
+    }
+    
+    // 只遍历块表中第 begin..end 个块（保存文件时分给多个线程）
+    template <typename Fn>
+    void for_each_live(size_t begin, size_t end, Fn&& fn) const {
+        for (size_t n = begin; n < end; n++) {
+            const ChunkType& chunk = chunks.chunks[n];
+            if (chunk.live_count == 0) continue;
+            
+            int64_t world_base_x = chunks.keys[n].x * Width;
+            int64_t world_base_y = chunks.keys[n].y * Width;
+            for (int i = 0; i < WORDS; i++) {
+                uint64_t word = chunk.bitmap[i];
+                int64_t x = world_base_x + (i % ROW_WORDS) * WORD_BITS;
+                int64_t y = world_base_y + i / ROW_WORDS;
+                while (word) {
+                    fn(x + __builtin_ctzll(word), y);
+                    word &= word - 1;
+                }
+            }
+        }
+    }
+    
+    // 区域按存储字批量操作（参数含义同 life_region），返回活细胞数的变化
+    template <typename Fn>
+    int64_t region_words(int64_t x0, int64_t y0, int64_t x1, int64_t y1, bool create,
+                         vector<LifeKey>& dirty, Fn&& fn) {
+        int64_t total = 0;
+        
+        // 以块为外层循环，每个块只查找一次
+        for (int64_t chunk_y = chunk_coord(y0); chunk_y <= chunk_coord(y1 - 1); chunk_y++) {
+            int64_t base_y = chunk_y * Width;
+            int ly0 = static_cast<int>(max(y0, base_y) - base_y);
+            int ly1 = static_cast<int>(min(y1, base_y + Width) - base_y);
+            
+            for (int64_t chunk_x = chunk_coord(x0); chunk_x <= chunk_coord(x1 - 1); chunk_x++) {
+                int64_t base_x = chunk_x * Width;
+                ChunkType* chunk = create ? chunks.get({chunk_x, chunk_y}) : chunks.lookup({chunk_x, chunk_y});
+                if (!chunk) continue;
+                
+                // 块内与区域相交的字列
+                int k0 = static_cast<int>(max(x0, base_x) - base_x) / WORD_BITS;
+                int k1 = static_cast<int>(min(x1, base_x + Width) - base_x - 1) / WORD_BITS;
+                int delta = 0;
+                bool changed = false;
+                for (int k = k0; k <= k1; k++) {
+                    int64_t word_x = base_x + k * WORD_BITS;
+                    int lo = static_cast<int>(max(x0, word_x) - word_x);
+                    int hi = static_cast<int>(min(x1, word_x + WORD_BITS) - word_x);
+                    uint64_t mask = (hi == 64 ? ~0ULL : ((1ULL << hi) - 1)) & ~((1ULL << lo) - 1);
+                    
+                    for (int ly = ly0; ly < ly1; ly++) {
+                        Word& word = chunk->bitmap[ly * ROW_WORDS + k];
+                        Word old = word;
+                        word = static_cast<Word>((old & ~mask) | (fn(static_cast<uint64_t>(old), mask, word_x, base_y + ly) & mask));
+                        delta += __builtin_popcountll(word) - __builtin_popcountll(old);
+                        changed |= word != old;
+                    }
+                }
+                
+                if (changed) {
+                    mark_stale({chunk_x, chunk_y}, *chunk);
+                    chunk->live_count += delta;
+                    total += delta;
+                    dirty.push_back({chunk_x, chunk_y});
+                }
+            }
+        }
+        return total;
+    }
+    
+    // 所有非空块的完整位图
+    template <typename Fn>
+    void snapshot(Fn&& fn) const {
+        uint64_t bits[RECORD_WORDS];
+        for (size_t n = 0; n < chunks.size(); n++) {
+            const ChunkType& chunk = chunks.chunks[n];
+            if (chunk.live_count == 0) continue;
+            memcpy(bits, chunk.bitmap, sizeof(chunk.bitmap));
+            fn(chunks.keys[n], bits, RECORD_WORDS);
+        }
+    }
+    
+    // 把一条记录异或进块，返回活细胞数的变化
+    int64_t xor_record(const LifeKey& key, const uint64_t* record, size_t words) {
+        ChunkType* chunk = chunks.get(key);
+        uint64_t bits[RECORD_WORDS];
+        memcpy(bits, chunk->bitmap, sizeof(chunk->bitmap));
+        int live = 0;
+        for (size_t i = 0; i < RECORD_WORDS; i++) {
+            if (i < words) bits[i] ^= record[i];
+            live += __builtin_popcountll(bits[i]);
+        }
+        memcpy(chunk->bitmap, bits, sizeof(chunk->bitmap));
+        int64_t delta = live - chunk->live_count;
+        mark_stale(key, *chunk);
+        chunk->live_count = live;
+        return delta;
+    }
+    
+    // 图案查找：以非空块中的活细胞为锚点格尝试各个朝向，块之间并行
+    // 每个块连同左右、下方覆盖图案所需的邻块按行拼成一段连续位图（各块的行按字节首尾相接，位序与世界 x 一致）
+    void find(const vector<FindPattern>& patterns, unsigned threads, vector<LifeMatch>& matches) const {
+        int max_width = 0, max_height = 0;
+        for (const FindPattern& pattern : patterns) {
+            max_width = max(max_width, pattern.width);
+            max_height = max(max_height, pattern.height);
+        }
+        // 锚点区域从块左边缘向左最多移动 max_width - 1 格，向右还要读到 Width + max_width - 2
+        const int left_chunks = (max_width + Width - 1) / Width;
+        const int grid_cols = left_chunks + 1 + (max_width + Width - 1) / Width;
+        const int rows = Width + max_height - 1;
+        const size_t stride = static_cast<size_t>(grid_cols * Width + 63) / 64 + 2;
+        
+        vector<vector<LifeMatch>> found(max(1u, threads));
+        parallel_for(threads, chunks.size(), 16, [&](size_t begin, size_t end, size_t index) {
+            vector<uint64_t> buf(stride * rows);
+            for (size_t n = begin; n < end; n++) {
+                if (chunks.chunks[n].live_count == 0) continue;
+                const LifeKey key = chunks.keys[n];
+                const int64_t grid_x = key.x - left_chunks;
+                
+                fill(buf.begin(), buf.end(), 0);
+                for (int gy = 0; gy * Width < rows; gy++) {
+                    for (int gx = 0; gx < grid_cols; gx++) {
+                        const ChunkType* chunk = chunks.find({grid_x + gx, key.y + gy});
+                        if (!chunk || chunk->live_count == 0) continue;
+                        for (int ly = 0; ly < Width && gy * Width + ly < rows; ly++) {
+                            char* row = reinterpret_cast<char*>(&buf[static_cast<size_t>(gy * Width + ly) * stride]);
+                            memcpy(row + gx * (Width / 8), &chunk->bitmap[ly * ROW_WORDS], Width / 8);
+                        }
+                    }
+                }
+                
+                for (const FindPattern& pattern : patterns) {
+                    const int64_t origin_x = key.x * Width - pattern.anchor;
+                    match_rows(pattern, buf.data(), stride, left_chunks * Width - pattern.anchor, Width, Width,
+                        [&](int dx, int dy) {
+                            found[index].push_back({origin_x + dx, key.y * Width + dy,
+                                                    pattern.width, pattern.height, pattern.orientation});
+                        });
+                }
+            }
+        });
+        for (auto& part : found) {
+            matches.insert(matches.end(), part.begin(), part.end());
+        }
+    }
+    
+    // 离块边缘不到 range 格处有活细胞的方向（这些细胞会影响对应的邻块），第 i 位对应 neighbor_offsets[i]
+    // range 不超过 LIFE_MAX_RANGE，小于最小的块宽度，所以只影响相邻的8个块
+    static int edge_mask(const ChunkType* chunk, int range) {
+        const Word* bitmap = chunk->bitmap;
+        const Word west_bits = (static_cast<Word>(1) << range) - 1;
+        const Word east_bits = west_bits << (WORD_BITS - range);
+        
+        Word north = 0, south = 0, west = 0, east = 0;
+        Word north_west = 0, north_east = 0, south_west = 0, south_east = 0;
+        for (int y = 0; y < Width; y++) {
+            const Word* row = bitmap + y * ROW_WORDS;
+            Word row_west = row[0] & west_bits;
+            Word row_east = row[ROW_WORDS - 1] & east_bits;
+            west |= row_west;
+            east |= row_east;
+            if (y < range || y >= Width - range) {
+                Word any = 0;
+                for (int k = 0; k < ROW_WORDS; k++) {
+                    any |= row[k];
+                }
+                if (y < range) {
+                    north |= any;
+                    north_west |= row_west;
+                    north_east |= row_east;
+                } else {
+                    south |= any;
+                    south_west |= row_west;
+                    south_east |= row_east;
+                }
+            }
+        }
+        
+        return (north_west != 0) << 0 |
+               (north != 0) << 1 |
+               (north_east != 0) << 2 |
+               (west != 0) << 3 |
+               (east != 0) << 4 |
+               (south_west != 0) << 5 |
+               (south != 0) << 6 |
+               (south_east != 0) << 7;
+    }
+    
+    // 找出本代参与演算的块：有活细胞的块，以及边缘活细胞所朝向的邻块（不存在则创建）
+    // 其余的空块下一代也不会有细胞诞生，直接释放；之后表中所有块都参与演算
+    void collect_active(int range) {
+        vector<LifeKey> missing;
+        for (auto& chunk : chunks.chunks) {
+            chunk.active = false;
+        }
+        for (size_t n = 0; n < chunks.size(); n++) {
+            ChunkType& chunk = chunks.chunks[n];
+            if (chunk.live_count == 0) continue;
+            chunk.active = true;
+            
+            const LifeKey key = chunks.keys[n];
+            int edges = edge_mask(&chunk, range);
+            for (int i = 0; i < 8; i++) {
+                if (!(edges & (1 << i))) continue;
+                LifeKey neighbor = {key.x + neighbor_offsets[i][0], key.y + neighbor_offsets[i][1]};
+                ChunkType* other = chunks.lookup(neighbor);
+                if (other) other->active = true;
+                else missing.push_back(neighbor);
+            }
+        }
+        for (auto& key : missing) {
+            chunks.get(key)->active = true;
+        }
+        // 将被删除的空块先把摘要清零
+        for (size_t n = 0; n < chunks.size(); n++) {
+            const ChunkType& chunk = chunks.chunks[n];
+            if (!chunk.active && chunk.occupancy_stale) update_occupancy(chunks.keys[n], chunk, OccupancyType());
+        }
+        chunks.compact([](const ChunkType& chunk) { return chunk.active; });
+    }
+    
+    // 把块及其8个邻块的边缘复制进带晕圈的缓冲区
+    // 晕圈字整字复制：演算只用到左晕圈字的最高位和右晕圈字的最低位
+    void fill_padded(const LifeKey& key, const ChunkType* chunk, Word* pad) const {
+        const ChunkType* around[8];
+        for (int i = 0; i < 8; i++) {
+            around[i] = chunks.find({key.x + neighbor_offsets[i][0], key.y + neighbor_offsets[i][1]});
+        }
+        const int last_row = (Width - 1) * ROW_WORDS;
+        
+        Word* top = pad;
+        top[0] = around[0] ? around[0]->bitmap[WORDS - 1] : 0;
+        for (int k = 0; k < ROW_WORDS; k++) {
+            top[k + 1] = around[1] ? around[1]->bitmap[last_row + k] : 0;
+        }
+        top[ROW_WORDS + 1] = around[2] ? around[2]->bitmap[last_row] : 0;
+        
+        for (int y = 0; y < Width; y++) {
+            Word* row = pad + (y + 1) * PAD_STRIDE;
+            row[0] = around[3] ? around[3]->bitmap[y * ROW_WORDS + ROW_WORDS - 1] : 0;
+            memcpy(row + 1, chunk->bitmap + y * ROW_WORDS, ROW_WORDS * sizeof(Word));
+            row[ROW_WORDS + 1] = around[4] ? around[4]->bitmap[y * ROW_WORDS] : 0;
+        }
+        
+        Word* bottom = pad + (Width + 1) * PAD_STRIDE;
+        bottom[0] = around[5] ? around[5]->bitmap[ROW_WORDS - 1] : 0;
+        for (int k = 0; k < ROW_WORDS; k++) {
+            bottom[k + 1] = around[6] ? around[6]->bitmap[k] : 0;
+        }
+        bottom[ROW_WORDS + 1] = around[7] ? around[7]->bitmap[0] : 0;
+    }
+    
+    // 通用规则：把块及其四周 range 格展开为字节数组（见 apply_rule）
+    void fill_cells(const LifeKey& key, const ChunkType* chunk, int range, vector<uint8_t>& cells) const {
+        // grid[1 + dy][1 + dx] 为相对位置 (dx, dy) 的块
+        const ChunkType* grid[3][3] = {};
+        grid[1][1] = chunk;
+        for (int i = 0; i < 8; i++) {
+            grid[1 + neighbor_offsets[i][1]][1 + neighbor_offsets[i][0]] =
+                chunks.find({key.x + neighbor_offsets[i][0], key.y + neighbor_offsets[i][1]});
+        }
+        
+        const int stride = Width + 2 * range;
+        cells.resize(static_cast<size_t>(stride) * stride);
+        for (int py = 0; py < stride; py++) {
+            int y = py - range;
+            int dy = y < 0 ? -1 : y >= Width ? 1 : 0;
+            int local_y = y - dy * Width;
+            uint8_t* row = &cells[static_cast<size_t>(py) * stride];
+            for (int px = 0; px < stride; px++) {
+                int x = px - range;
+                int dx = x < 0 ? -1 : x >= Width ? 1 : 0;
+                const ChunkType* source = grid[1 + dy][1 + dx];
+                row[px] = source && source->get_bit(x - dx * Width, local_y);
+            }
+        }
+    }
+    
+    // 由带晕圈的缓冲区算出块的下一代
+    static void step_padded(const Word* pad, Word* out) {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+        if constexpr (ROW_WORDS == 1) {
+            // 每行一个字：先把左右晕圈字的边缘位移到位，再一次处理多行
+            constexpr int TOP = WORD_BITS - 1;
+            Word mid[Width + 2], west_in[Width + 2], east_in[Width + 2];
+            for (int y = 0; y < Width + 2; y++) {
+                mid[y] = pad[y * PAD_STRIDE + 1];
+                west_in[y] = pad[y * PAD_STRIDE] >> TOP;
+                east_in[y] = pad[y * PAD_STRIDE + 2] << TOP;
+            }
+            life_rows_neon(mid, west_in, east_in, out, Width);
+            return;
+        }
+#endif
+        for (int y = 0; y < Width; y++) {
+            const Word* above = pad + y * PAD_STRIDE;
+            for (int k = 0; k < ROW_WORDS; k++) {
+                out[y * ROW_WORDS + k] = life_word(above, above + PAD_STRIDE, above + 2 * PAD_STRIDE, k + 1);
+            }
+        }
+    }
+    
+    // 演算一代，返回新的活细胞总数
+    // 变化过的块加入 dirty；fn 非空时对每个变化块调用 fn(key, 与上一代的异或差分)
+    template <typename Fn>
+    int64_t step(const RuleTable& rule, unsigned threads, vector<LifeKey>& dirty, Fn&& fn) {
+        collect_active(rule.range);
+        const size_t count = chunks.size();
+        next.resize(count * WORDS);
+        next_live.resize(count);
+        
+        // 各块只读当前位图、只写自己的 next 区间，可以并行
+        parallel_for(threads, count, max(1, 4096 / WORDS), [&](size_t begin, size_t end, size_t) {
+            Word pad[PAD_WORDS];
+            RuleScratch scratch;
+            for (size_t i = begin; i < end; i++) {
+                Word* out = &next[i * WORDS];
+                if (rule.conway) {
+                    fill_padded(chunks.keys[i], &chunks.chunks[i], pad);
+                    step_padded(pad, out);
+                } else {
+                    fill_cells(chunks.keys[i], &chunks.chunks[i], rule.range, scratch.cells);
+                    memset(out, 0, WORDS * sizeof(Word));
+                    apply_rule(rule, Width, Width, scratch, [&](int x, int y) {
+                        out[ChunkType::word_index(x, y)] |= ChunkType::bit_mask(x);
+                    });
+                }
+                int live = 0;
+                for (int k = 0; k < WORDS; k++) {
+                    live += __builtin_popcountll(out[k]);
+                }
+                next_live[i] = live;
+            }
+        });
+        
+        // 写回
+        int64_t population = 0;
+        uint64_t diff[RECORD_WORDS];
+        for (size_t i = 0; i < count; i++) {
+            ChunkType& chunk = chunks.chunks[i];
+            const Word* out = &next[i * WORDS];
+            population += next_live[i];
+            if (memcmp(out, chunk.bitmap, sizeof(chunk.bitmap)) == 0) continue;
+            
+            if constexpr (!is_same_v<decay_t<Fn>, nullptr_t>) {
+                uint64_t before[RECORD_WORDS];
+                memcpy(before, chunk.bitmap, sizeof(chunk.bitmap));
+                memcpy(diff, out, sizeof(chunk.bitmap));
+                for (size_t j = 0; j < RECORD_WORDS; j++) {
+                    diff[j] ^= before[j];
+                }
+                fn(chunks.keys[i], diff, RECORD_WORDS);
+            }
+            memcpy(chunk.bitmap, out, sizeof(chunk.bitmap));
+            mark_stale(chunks.keys[i], chunk);
+            chunk.live_count = next_live[i];
+            dirty.push_back(chunks.keys[i]);
+        }
+        return population;
+    }
+};
+
+// 编译进程序的块几何，运行时选择
+using PlaneWorld = variant<ChunkWorld<32, uint32_t>, ChunkWorld<64, uint64_t>,
+                           ChunkWorld<128, uint64_t>, ChunkWorld<256, uint64_t>>;
+
+// 块宽度 -> PlaneWorld 中的下标，不支持的宽度返回 -1
+constexpr int chunk_size_index(int size) {
+    return size == 32 ? 0 : size == 64 ? 1 : size == 128 ? 2 : size == 256 ? 3 : -1;
+}
+static_assert(chunk_size_index(DEFAULT_CHUNK_SIZE) >= 0, "DEFAULT_CHUNK_SIZE must be one of the compiled chunk sizes");
+
+// 固定尺寸世界：连续位图，每行两端各有一个晕圈字，上下各有一行晕圈
+// 第 y 行的数据位于 row(y)[1..words]，x 对应第 1 + x/64 个字的第 x%64 位
+struct DenseWorld {
+    int64_t width = 0;
+    int64_t height = 0;
+    size_t words = 0;        // 每行数据字数
+    size_t stride = 0;       // 每行总字数（含左右晕圈字）
+    uint64_t tail_mask = 0;  // 最后一个数据字中的有效位
+    vector<uint64_t> cells;
+    vector<uint64_t> next;
+    
+    // 活细胞的包围盒与坐标和：编辑单个细胞时增量维护；演算、批量修改或删掉包围盒边上的细胞后标记为过期，
+    // 下次查询时重新扫描一遍（固定尺寸世界至多 2^32 格，扫描一遍比演算一代还快）
+    mutable Extent extent;
+    mutable bool extent_stale = false;
+    
+    void init(int64_t w, int64_t h) {
+        width = w;
+        height = h;
+        words = static_cast<size_t>((w + 63) / 64);
+        stride = words + 2;
+        tail_mask = (w % 64 == 0) ? ~0ULL : ((1ULL << (w % 64)) - 1);
+        cells.assign(stride * static_cast<size_t>(h + 2), 0);
+        next.assign(stride * static_cast<size_t>(h + 2), 0);
+        extent = Extent();
+        extent_stale = false;
+    }
+    
+    // y 取 -1..height，-1 和 height 为晕圈行
+    uint64_t* row(int64_t y) { return &cells[static_cast<size_t>(y + 1) * stride]; }
+    const uint64_t* row(int64_t y) const { return &cells[static_cast<size_t>(y + 1) * stride]; }
+    uint64_t* next_row(int64_t y) { return &next[static_cast<size_t>(y + 1) * stride]; }
+    
+    inline bool get_bit(int64_t x, int64_t y) const {
+        return (row(y)[1 + x / 64] >> (x % 64)) & 1;
+    }
+    
+    inline void set_bit(int64_t x, int64_t y, bool value) {
+        uint64_t mask = 1ULL << (x % 64);
+        uint64_t& word = row(y)[1 + x / 64];
+        word = value ? (word | mask) : (word & ~mask);
+    }
+    
+    const Extent& current_extent() const {
+        if (!extent_stale) return extent;
+        extent = Extent();
+        uint64_t first_column = ~0ULL, last_column = 0;  // 最左/最右活细胞的 x
+        for (int64_t y = 0; y < height; y++) {
+            const uint64_t* data = row(y) + 1;
+            int64_t row_live = 0;
+            for (size_t k = 0; k < words; k++) {
+                uint64_t word = data[k];
+                if (!word) continue;
+                int64_t count = __builtin_popcountll(word);
+                int64_t base_x = static_cast<int64_t>(k) * 64;
+                row_live += count;
+                extent.sum_x += static_cast<__int128>(count) * base_x + bit_position_sum(word);
+                first_column = min<uint64_t>(first_column, base_x + __builtin_ctzll(word));
+                last_column = max<uint64_t>(last_column, base_x + 63 - __builtin_clzll(word));
+            }
+            if (row_live) {
+                extent.min_y = min(extent.min_y, y);
+                extent.max_y = y;
+                extent.sum_y += static_cast<__int128>(row_live) * y;
+            }
+        }
+        if (extent.max_y >= 0) {
+            extent.min_x = static_cast<int64_t>(first_column);
+            extent.max_x = static_cast<int64_t>(last_column);
+        }
+        extent_stale = false;
+        return extent;
+    }
+    
+    // 单个细胞的增减：增加时扩展包围盒，删掉包围盒边上的细胞时标记为过期
+    void update_extent(int64_t x, int64_t y, bool alive) {
+        if (extent_stale) return;
+        if (alive) {
+            extent.min_x = min(extent.min_x, x);
+            extent.max_x = max(extent.max_x, x);
+            extent.min_y = min(extent.min_y, y);
+            extent.max_y = max(extent.max_y, y);
+            extent.sum_x += x;
+            extent.sum_y += y;
+        } else {
+            extent.sum_x -= x;
+            extent.sum_y -= y;
+            extent_stale = x == extent.min_x || x == extent.max_x || y == extent.min_y || y == extent.max_y;
+        }
+    }
+};
+
+struct LifeWorld {
+    // 无界平面使用块存储，块几何在运行时选择
+    PlaneWorld plane{in_place_index<chunk_size_index(DEFAULT_CHUNK_SIZE)>};
+    
+    // 环面/有界平面使用连续位图
+    LifeTopology topology = LIFE_PLANE;
+    DenseWorld dense;
+    
+    RuleTable rule;
+    int64_t population = 0;
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    vector<LifeKey> dirty;
+};
+
+// 把世界坐标映射到固定尺寸世界内：环面取模，有界平面越界返回 false
+static inline bool dense_coord(const LifeWorld* world, int64_t& world_x, int64_t& world_y) {
+    const DenseWorld& dense = world->dense;
+    if (world->topology == LIFE_TORUS) {
+        world_x %= dense.width;
+        world_y %= dense.height;
+        if (world_x < 0) world_x += dense.width;
+        if (world_y < 0) world_y += dense.height;
+        return true;
+    }
+    return world_x >= 0 && world_x < dense.width && world_y >= 0 && world_y < dense.height;
+}
+
+// 通用规则的固定尺寸世界演算（第 row_begin..row_end 行）：按 64 行 x 1024 列的分块连同四周 R 格展开为字节数组
+// 环面按取模回绕，有界平面越界处为0
+static void step_dense_rule(LifeWorld* world, int64_t row_begin, int64_t row_end, int64_t& population, bool& changed) {
+    DenseWorld& dense = world->dense;
+    const RuleTable& rule = world->rule;
+    const int r = rule.range;
+    const int64_t width = dense.width;
+    const int64_t height = dense.height;
+    const bool torus = world->topology == LIFE_TORUS;
+    const int64_t TILE_ROWS = 64, TILE_COLS = 1024;
+    RuleScratch scratch;
+    
+    for (int64_t y0 = row_begin; y0 < row_end; y0 += TILE_ROWS) {
+        const int rows = static_cast<int>(min(TILE_ROWS, row_end - y0));
+        for (int y = 0; y < rows; y++) {
+            memset(dense.next_row(y0 + y) + 1, 0, dense.words * sizeof(uint64_t));
+        }
+        
+        for (int64_t x0 = 0; x0 < width; x0 += TILE_COLS) {
+            const int cols = static_cast<int>(min(TILE_COLS, width - x0));
+            const int stride = cols + 2 * r;
+            scratch.cells.assign(static_cast<size_t>(rows + 2 * r) * stride, 0);
+            for (int py = 0; py < rows + 2 * r; py++) {
+                int64_t y = y0 + py - r;
+                if (torus) y = (y % height + height) % height;
+                else if (y < 0 || y >= height) continue;
+                
+                const uint64_t* row = dense.row(y) + 1;
+                uint8_t* out = &scratch.cells[static_cast<size_t>(py) * stride];
+                for (int px = 0; px < stride; px++) {
+                    int64_t x = x0 + px - r;
+                    if (torus) x = (x % width + width) % width;
+                    else if (x < 0 || x >= width) continue;
+                    out[px] = (row[x >> 6] >> (x & 63)) & 1;
+                }
+            }
+            
+            apply_rule(rule, cols, rows, scratch, [&](int x, int y) {
+                int64_t world_x = x0 + x;
+                dense.next_row(y0 + y)[1 + (world_x >> 6)] |= 1ULL << (world_x & 63);
+            });
+        }
+        
+        for (int y = 0; y < rows; y++) {
+            const uint64_t* current = dense.row(y0 + y) + 1;
+            const uint64_t* next = dense.next_row(y0 + y) + 1;
+            for (size_t i = 0; i < dense.words; i++) {
+                uint64_t c = (i + 1 == dense.words) ? (current[i] & dense.tail_mask) : current[i];
+                changed |= next[i] != c;
+                population += __builtin_popcountll(next[i]);
+            }
+        }
+    }
+}
+
+// 环面中从 x 开始（取模回绕）的64个细胞
+static uint64_t wrapped_bits(const uint64_t* row, int64_t width, int64_t x) {
+    uint64_t value = 0;
+    for (int got = 0; got < 64;) {
+        int64_t pos = x % width;
+        int count = static_cast<int>(min<int64_t>(64 - got, width - pos));
+        uint64_t bits = read_bits64(row, pos);
+        if (count < 64) bits &= (1ULL << count) - 1;
+        value |= bits << got;
+        got += count;
+        x += count;
+    }
+    return value;
+}
+
+// 固定尺寸世界的图案查找：按64行一段并行
+// 有界平面直接在位图上匹配包围盒完全落在世界内的位置；环面先把每行展开为回绕后的副本（上下同样回绕）
+static void find_dense(const LifeWorld* world, const vector<FindPattern>& patterns, vector<LifeMatch>& matches) {
+    const DenseWorld& dense = world->dense;
+    const bool torus = world->topology == LIFE_TORUS;
+    const int64_t BAND_ROWS = 64;
+    int max_width = 0, max_height = 0;
+    for (const FindPattern& pattern : patterns) {
+        max_width = max(max_width, pattern.width);
+        max_height = max(max_height, pattern.height);
+    }
+    const size_t stride = static_cast<size_t>(dense.width + max_width + 63) / 64 + 2;
+    
+    const size_t bands = static_cast<size_t>((dense.height + BAND_ROWS - 1) / BAND_ROWS);
+    vector<vector<LifeMatch>> found(max(1u, world->threads));
+    parallel_for(world->threads, bands, 1, [&](size_t begin, size_t end, size_t index) {
+        vector<uint64_t> buf;
+        for (size_t band = begin; band < end; band++) {
+            const int64_t y0 = static_cast<int64_t>(band) * BAND_ROWS;
+            const int band_rows = static_cast<int>(min(BAND_ROWS, dense.height - y0));
+            if (torus) {
+                buf.assign(stride * (band_rows + max_height - 1), 0);
+                for (int r = 0; r < band_rows + max_height - 1; r++) {
+                    const uint64_t* row = dense.row((y0 + r) % dense.height) + 1;
+                    for (size_t k = 0; k + 2 < stride; k++) {
+                        buf[r * stride + k] = wrapped_bits(row, dense.width, static_cast<int64_t>(k) * 64);
+                    }
+                }
+            }
+            
+            for (const FindPattern& pattern : patterns) {
+                auto emit = [&](int dx, int dy) {
+                    found[index].push_back({dx, y0 + dy, pattern.width, pattern.height, pattern.orientation});
+                };
+                if (torus) {
+                    if (pattern.width > dense.width || pattern.height > dense.height) continue;
+                    match_rows(pattern, buf.data(), stride, 0, static_cast<int>(dense.width), band_rows, emit);
+                } else {
+                    int64_t cols = dense.width - pattern.width + 1;
+                    int64_t rows = min<int64_t>(band_rows, dense.height - pattern.height + 1 - y0);
+                    if (cols <= 0 || rows <= 0) continue;
+                    match_rows(pattern, dense.row(y0), dense.stride, 64, static_cast<int>(cols), static_cast<int>(rows), emit);
+                }
+            }
+        }
+    });
+    for (auto& part : found) {
+        matches.insert(matches.end(), part.begin(), part.end());
+    }
+}
+
+// 固定尺寸世界的位并行演算：一次处理64个细胞
+// 边界由晕圈处理：环面把对边复制进晕圈，有界平面的晕圈保持为0
+template <typename Fn>
+static void step_dense(LifeWorld* world, Fn&& fn) {
+    DenseWorld& dense = world->dense;
+    const int64_t width = dense.width;
+    const int64_t height = dense.height;
+    const size_t words = dense.words;
+    
+    if (world->topology == LIFE_TORUS) {
+        // 左右晕圈：x=-1 处放最后一列，x=width 处放第一列
+        size_t west_word = 1 + (width - 1) / 64;
+        int west_bit = (width - 1) % 64;
+        size_t east_word = 1 + width / 64;
+        int east_bit = width % 64;
+        for (int64_t y = 0; y < height; y++) {
+            uint64_t* row = dense.row(y);
+            row[0] = ((row[west_word] >> west_bit) & 1) << 63;
+            row[east_word] = (row[east_word] & ~(1ULL << east_bit)) | ((row[1] & 1) << east_bit);
+        }
+        // 上下晕圈整行复制（包括已填好的左右晕圈，角落自然正确）
+        memcpy(dense.row(-1), dense.row(height - 1), dense.stride * sizeof(uint64_t));
+        memcpy(dense.row(height), dense.row(0), dense.stride * sizeof(uint64_t));
+    }
+    
+    // 按行分给多个线程，每个线程统计自己的细胞数
+    vector<int64_t> populations(world->threads, 0);
+    vector<char> changes(world->threads, 0);
+    
+    parallel_for(world->threads, static_cast<size_t>(height), max<size_t>(16, 65536 / dense.stride),
+        [&](size_t row_begin, size_t row_end, size_t part) {
+        int64_t population = 0;
+        bool changed = false;
+        if (!world->rule.conway) {
+            step_dense_rule(world, row_begin, row_end, population, changed);
+            populations[part] = population;
+            changes[part] = changed;
+            return;
+        }
+        
+        for (int64_t y = row_begin; y < static_cast<int64_t>(row_end); y++) {
+            const uint64_t* above = dense.row(y - 1);
+            const uint64_t* current = dense.row(y);
+            const uint64_t* below = dense.row(y + 1);
+            uint64_t* out = dense.next_row(y);
+            
+            for (size_t i = 1; i <= words; i++) {
+                uint64_t c = current[i];
+                uint64_t result = life_word(above, current, below, i);
+                if (i == words) result &= dense.tail_mask;
+                out[i] = result;
+                
+                changed |= (result != (i == words ? (c & dense.tail_mask) : c));
+                population += __builtin_popcountll(result);
+            }
+        }
+        
+        populations[part] = population;
+        changes[part] = changed;
+    });
+    
+    dense.cells.swap(dense.next);
+    world->population = accumulate(populations.begin(), populations.end(), int64_t(0));
+    if (find(changes.begin(), changes.end(), 1) == changes.end()) return;
+    world->dirty.push_back({0, 0});
+    dense.extent_stale = true;
+    
+    // 交换后 next 缓冲区中正好是上一代，逐行求差分
+    if constexpr (!is_same_v<decay_t<Fn>, nullptr_t>) {
+        vector<uint64_t> diff(words);
+        for (int64_t y = 0; y < height; y++) {
+            const uint64_t* now = dense.row(y) + 1;
+            const uint64_t* before = dense.next_row(y) + 1;
+            bool row_changed = false;
+            for (size_t i = 0; i < words; i++) {
+                diff[i] = now[i] ^ before[i];
+                if (i + 1 == words) diff[i] &= dense.tail_mask;
+                row_changed |= diff[i] != 0;
+            }
+            if (row_changed) fn(LifeKey{0, y}, diff.data(), words);
+        }
+    }
+}
+
+// 固定尺寸世界第 y0..y1 行的活细胞
+template <typename Fn>
+static void for_each_live_rows(const DenseWorld& dense, int64_t y0, int64_t y1, Fn&& fn) {
+    for (int64_t y = y0; y < y1; y++) {
+        const uint64_t* row = dense.row(y);
+        for (size_t i = 0; i < dense.words; i++) {
+            uint64_t word = row[i + 1];
+            if (i + 1 == dense.words) word &= dense.tail_mask;
+            while (word) {
+                fn(static_cast<int64_t>(i * 64 + __builtin_ctzll(word)), y);
+                word &= word - 1;
+            }
+        }
+    }
+}
+
+// 读文件时每个线程至少分到的字节数
+const size_t LOAD_MIN_BYTES = 1 << 20;
+// 保存文件时每个线程每批格式化的细胞格数（按块或行的面积估计）
+const size_t SAVE_BATCH_CELLS = 1 << 20;
+
+// 文件内容：普通文件用 mmap 映射，管道等不能映射的文件整个读入内存
+struct FileText {
+    const char* data = nullptr;
+    size_t size = 0;
+    void* mapped = nullptr;
+    string buffer;
+    
+    bool open(const char* filename) {
+        int fd = ::open(filename, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void* p = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+                mapped = p;
+                data = static_cast<const char*>(p);
+                size = static_cast<size_t>(info.st_size);
+                close(fd);
+                return true;
+            }
+        }
+        
+        char block[65536];
+        ssize_t n;
+        while ((n = read(fd, block, sizeof(block))) > 0) buffer.append(block, static_cast<size_t>(n));
+        close(fd);
+        if (n < 0) return false;
+        data = buffer.data();
+        size = buffer.size();
+        return true;
+    }
+    
+    ~FileText() {
+        if (mapped) munmap(mapped, size);
+    }
+};
+
+// 一个线程解析的文本分片
+struct LoadShard {
+    vector<pair<size_t, string>> comments;  // 注释行及其偏移
+    size_t error = SIZE_MAX;                // 第一处格式错误所在行的偏移
+};
+
+// offset 之后（含）的第一个行首；offset 本身在行首时原样返回
+static size_t line_start(const char* data, size_t size, size_t offset) {
+    if (offset == 0 || offset >= size) return min(offset, size);
+    const void* newline = memchr(data + offset - 1, '\n', size - offset + 1);
+    return newline ? static_cast<size_t>(static_cast<const char*>(newline) - data) + 1 : size;
+}
+
+// 解析一个坐标（可带前导空白和正负号），失败返回 nullptr
+static const char* parse_coord(const char* p, const char* end, int64_t& value) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f')) p++;
+    if (p + 1 < end && *p == '+' && p[1] >= '0' && p[1] <= '9') p++;
+    from_chars_result result = from_chars(p, end, value);
+    return result.ec == errc() ? result.ptr : nullptr;
+}
+
+// 逐行解析 [begin, end)（两端都在行首），对每个坐标调用 cell(x, y)，遇到格式错误时停止
+template <typename Cell>
+static void parse_lines(const char* data, size_t begin, size_t end, LoadShard& shard, Cell&& cell) {
+    size_t pos = begin;
+    while (pos < end) {
+        const char* line = data + pos;
+        const char* newline = static_cast<const char*>(memchr(line, '\n', end - pos));
+        const char* stop = newline ? newline : data + end;
+        size_t next = newline ? static_cast<size_t>(newline - data) + 1 : end;
+        if (stop > line && stop[-1] == '\r') stop--;
+        
+        if (stop > line && *line == '#') {
+            shard.comments.emplace_back(pos, string(line, stop));
+        } else if (stop > line) {
+            int64_t x, y;
+            const char* p = parse_coord(line, stop, x);
+            if (p) p = parse_coord(p, stop, y);
+            if (!p || !in_world(x, y)) {
+                shard.error = pos;
+                return;
+            }
+            cell(x, y);
+        }
+        pos = next;
+    }
+}
+
+// 并行读入 Life 1.06 文本的前 limit 个字节（世界须为空）：按字节范围分给各线程，边界对齐到行首
+// 无界平面：各线程把细胞写进自己的块表，块表按键哈希分组，各组并行合并后整块写入世界，每个块只查找一次
+// 固定尺寸世界：各线程以原子或直接写入位图，之后重新统计活细胞数
+// 有格式错误时不写入无界平面，返回第一处错误的偏移（固定尺寸世界已写入，由调用方清空）；否则返回 SIZE_MAX
+static size_t load_text(LifeWorld* world, const char* data, size_t limit, vector<pair<size_t, string>>& comments) {
+    const unsigned threads = world->threads;
+    vector<LoadShard> shards(threads);
+    auto parse_shards = [&](auto&& cell) {
+        parallel_for(threads, limit, LOAD_MIN_BYTES, [&](size_t begin, size_t end, size_t index) {
+            parse_lines(data, line_start(data, limit, begin), line_start(data, limit, end), shards[index],
+                        [&](int64_t x, int64_t y) { cell(index, x, y); });
+        });
+    };
+    auto first_error = [&]() {
+        for (LoadShard& shard : shards) {
+            comments.insert(comments.end(), shard.comments.begin(), shard.comments.end());
+            if (shard.error != SIZE_MAX) return shard.error;
+        }
+        return SIZE_MAX;
+    };
+    
+    if (world->topology != LIFE_PLANE) {
+        DenseWorld& dense = world->dense;
+        parse_shards([&](size_t, int64_t x, int64_t y) {
+            if (!dense_coord(world, x, y)) return;
+            __atomic_fetch_or(&dense.row(y)[1 + x / 64], 1ULL << (x % 64), __ATOMIC_RELAXED);
+        });
+        
+        vector<int64_t> populations(threads, 0);
+        parallel_for(threads, static_cast<size_t>(dense.height), 1024, [&](size_t begin, size_t end, size_t index) {
+            for (size_t y = begin; y < end; y++) {
+                const uint64_t* row = dense.row(static_cast<int64_t>(y)) + 1;
+                for (size_t i = 0; i < dense.words; i++) populations[index] += __builtin_popcountll(row[i]);
+            }
+        });
+        world->population = accumulate(populations.begin(), populations.end(), int64_t(0));
+        dense.extent_stale = true;
+        world->dirty.push_back({0, 0});
+        return first_error();
+    }
+    
+    return visit([&](auto& plane) {
+        using Plane = decay_t<decltype(plane)>;
+        using Record = array<uint64_t, Plane::RECORD_WORDS>;
+        const size_t groups = threads;
+        vector<vector<ChunkTable<Record>>> tables(threads, vector<ChunkTable<Record>>(groups));
+        vector<pair<LifeKey, uint64_t*>> last(threads, {LifeKey{0, 0}, nullptr});
+        
+        parse_shards([&](size_t index, int64_t x, int64_t y) {
+            // 同一块连续出现时不再查找（只有向同一张表插入时指针才会失效，而插入后立即更新）
+            LifeKey key = {Plane::chunk_coord(x), Plane::chunk_coord(y)};
+            auto& cached = last[index];
+            if (!cached.second || !(cached.first == key)) {
+                size_t group = (static_cast<uint64_t>(ChunkKeyHash()(key)) * groups) >> 32;
+                cached = {key, tables[index][group].get(key)->data()};
+            }
+            // 记录的位序同块位图：块内第 ly 行第 lx 个细胞为第 ly * Width + lx 位
+            size_t bit = static_cast<size_t>(Plane::local_coord(y)) * Plane::SIZE + Plane::local_coord(x);
+            cached.second[bit / 64] |= 1ULL << (bit % 64);
+        });
+        size_t error = first_error();
+        if (error != SIZE_MAX) return error;
+        
+        parallel_for(threads, groups, 1, [&](size_t begin, size_t end, size_t) {
+            for (size_t group = begin; group < end; group++) {
+                ChunkTable<Record>& merged = tables[0][group];
+                for (size_t index = 1; index < threads; index++) {
+                    ChunkTable<Record>& part = tables[index][group];
+                    for (size_t n = 0; n < part.size(); n++) {
+                        Record& target = *merged.get(part.keys[n]);
+                        for (size_t i = 0; i < Plane::RECORD_WORDS; i++) target[i] |= part.chunks[n][i];
+                    }
+                    part.clear();
+                }
+            }
+        });
+        
+        for (ChunkTable<Record>& merged : tables[0]) {
+            for (size_t n = 0; n < merged.size(); n++) {
+                world->population += plane.xor_record(merged.keys[n], merged.chunks[n].data(), Plane::RECORD_WORDS);
+                world->dirty.push_back(merged.keys[n]);
+            }
+        }
+        return SIZE_MAX;
+    }, world->plane);
+}
+
+// 以 Life 1.06 格式追加一个坐标
+static inline void append_cell(string& out, int64_t x, int64_t y) {
+    char buffer[48];
+    char* p = to_chars(buffer, buffer + 20, x).ptr;
+    *p++ = ' ';
+    p = to_chars(p, p + 20, y).ptr;
+    *p++ = '\n';
+    out.append(buffer, p);
+}
+
+extern "C" {
+
+LifeWorld* life_create(void) {
+    return new LifeWorld();
+}
+
+void life_destroy(LifeWorld* world) {
+    delete world;
+}
+
+bool life_set_chunk_size(LifeWorld* world, int size) {
+    if (chunk_size_index(size) < 0) return false;
+    
+    life_clear(world);
+    switch (size) {
+        case 32: world->plane.emplace<chunk_size_index(32)>(); break;
+        case 64: world->plane.emplace<chunk_size_index(64)>(); break;
+        case 128: world->plane.emplace<chunk_size_index(128)>(); break;
+        case 256: world->plane.emplace<chunk_size_index(256)>(); break;
+    }
+    return true;
+}
+
+int life_chunk_size(const LifeWorld* world) {
+    return visit([](auto& plane) { return plane.SIZE; }, world->plane);
+}
+
+int64_t life_chunk_coord(const LifeWorld* world, int64_t coord) {
+    return visit([&](auto& plane) { return plane.chunk_coord(coord); }, world->plane);
+}
+
+bool life_set_topology(LifeWorld* world, LifeTopology topology, int64_t width, int64_t height) {
+    if (topology != LIFE_PLANE) {
+        // 单个位图最多 2^32 个细胞（512MB）
+        if (width < 1 || height < 1 || width > (1 << 20) || height > (1 << 20) ||
+            width * height > (1LL << 32)) return false;
+    }
+    
+    life_clear(world);
+    world->topology = topology;
+    if (topology == LIFE_PLANE) {
+        world->dense = DenseWorld();
+    } else {
+        world->dense.init(width, height);
+    }
+    return true;
+}
+
+bool life_set_rule(LifeWorld* world, const char* rule) {
+    return parse_rule(rule, world->rule);
+}
+
+const char* life_rule(const LifeWorld* world) {
+    return world->rule.name.c_str();
+}
+
+LifeTopology life_topology(const LifeWorld* world) {
+    return world->topology;
+}
+
+int64_t life_width(const LifeWorld* world) {
+    return world->dense.width;
+}
+
+int64_t life_height(const LifeWorld* world) {
+    return world->dense.height;
+}
+
+void life_set_threads(LifeWorld* world, unsigned threads) {
+    world->threads = max(1u, threads);
+}
+
+unsigned life_threads(const LifeWorld* world) {
+    return world->threads;
+}
+
+void life_clear(LifeWorld* world) {
+    visit([](auto& plane) { plane.clear(); }, world->plane);
+    fill(world->dense.cells.begin(), world->dense.cells.end(), 0);
+    world->dense.extent = Extent();
+    world->dense.extent_stale = false;
+    world->population = 0;
+}
+
+bool life_get(LifeWorld* world, int64_t x, int64_t y) {
+    if (world->topology != LIFE_PLANE) {
+        return dense_coord(world, x, y) && world->dense.get_bit(x, y);
+    }
+    return visit([&](auto& plane) { return plane.peek(x, y); }, world->plane);
+}
+
+int life_set(LifeWorld* world, int64_t x, int64_t y, bool alive) {
+    if (world->topology != LIFE_PLANE) {
+        if (!dense_coord(world, x, y) || world->dense.get_bit(x, y) == alive) return 0;
+        world->dense.set_bit(x, y, alive);
+        world->dense.update_extent(x, y, alive);
+        int delta = alive ? 1 : -1;
+        world->population += delta;
+        
+        // 固定尺寸世界重绘时按视口处理
+        world->dirty.push_back({0, 0});
+        return delta;
+    }
+    
+    int delta = visit([&](auto& plane) { return plane.set(x, y, alive, world->dirty); }, world->plane);
+    world->population += delta;
+    return delta;
+}
+
+int64_t life_population(const LifeWorld* world) {
+    return world->population;
+}
+
+int64_t life_step(LifeWorld* world, LifeRecordFn on_delta, void* ctx) {
+    if (world->population == 0) return 0;
+    
+    auto emit = [&](const LifeKey& key, const uint64_t* bits, size_t words) {
+        on_delta(ctx, key, bits, words);
+    };
+    auto no_delta = nullptr;
+    if (world->topology != LIFE_PLANE) {
+        if (on_delta) step_dense(world, emit);
+        else step_dense(world, no_delta);
+        return world->population;
+    }
+    
+    world->population = visit([&](auto& plane) {
+        return on_delta ? plane.step(world->rule, world->threads, world->dirty, emit)
+                        : plane.step(world->rule, world->threads, world->dirty, no_delta);
+    }, world->plane);
+    return world->population;
+}
+
+const LifeKey* life_dirty(const LifeWorld* world, size_t* count) {
+    *count = world->dirty.size();
+    return world->dirty.data();
+}
+
+void life_clear_dirty(LifeWorld* world) {
+    world->dirty.clear();
+}
+
+void life_for_each_live(const LifeWorld* world, LifeCellFn fn, void* ctx) {
+    if (world->topology != LIFE_PLANE) {
+        for_each_live_rows(world->dense, 0, world->dense.height, [&](int64_t x, int64_t y) { fn(ctx, x, y); });
+        return;
+    }
+    
+    visit([&](auto& plane) { plane.for_each_live([&](int64_t x, int64_t y) { fn(ctx, x, y); }); }, world->plane);
+}
+
+int64_t life_region(LifeWorld* world, int64_t x0, int64_t y0, int64_t x1, int64_t y1,
+                    bool create, LifeWordFn fn, void* ctx) {
+    if (world->topology != LIFE_PLANE) {
+        // 固定尺寸世界：区域裁剪到世界范围内
+        DenseWorld& dense = world->dense;
+        x0 = max<int64_t>(x0, 0);
+        y0 = max<int64_t>(y0, 0);
+        x1 = min<int64_t>(x1, dense.width);
+        y1 = min<int64_t>(y1, dense.height);
+        if (x0 >= x1 || y0 >= y1) return 0;
+        
+        int64_t delta = 0;
+        for (int64_t y = y0; y < y1; y++) {
+            uint64_t* row = dense.row(y);
+            for (int64_t k = x0 >> 6; k <= (x1 - 1) >> 6; k++) {
+                int64_t base_x = k * 64;
+                int lo = static_cast<int>(max(x0, base_x) - base_x);
+                int hi = static_cast<int>(min(x1, base_x + 64) - base_x);
+                uint64_t mask = (hi == 64 ? ~0ULL : ((1ULL << hi) - 1)) & ~((1ULL << lo) - 1);
+                uint64_t old = row[k + 1];
+                uint64_t value = (old & ~mask) | (fn(ctx, old, mask, base_x, y) & mask);
+                delta += __builtin_popcountll(value) - __builtin_popcountll(old);
+                row[k + 1] = value;
+            }
+        }
+        dense.extent_stale = true;
+        world->population += delta;
+        if (delta) world->dirty.push_back({0, 0});
+        return delta;
+    }
+    
+    if (x0 >= x1 || y0 >= y1 || !in_world(x0, y0) || !in_world(x1 - 1, y1 - 1)) return 0;
+    
+    int64_t delta = visit([&](auto& plane) {
+        return plane.region_words(x0, y0, x1, y1, create, world->dirty,
+            [&](uint64_t old, uint64_t mask, int64_t base_x, int64_t y) { return fn(ctx, old, mask, base_x, y); });
+    }, world->plane);
+    world->population += delta;
+    return delta;
+}
+
+int64_t life_find(const LifeWorld* world, const uint64_t* bits, int width, int height, LifeMatchFn fn, void* ctx) {
+    if (width <= 0 || height <= 0 || width > LIFE_MAX_FIND || height > LIFE_MAX_FIND) return -1;
+    vector<FindPattern> patterns = pattern_orientations(bits, width, height);
+    if (patterns.empty()) return -1;
+    
+    vector<LifeMatch> matches;
+    if (world->topology != LIFE_PLANE) {
+        find_dense(world, patterns, matches);
+    } else {
+        visit([&](auto& plane) { plane.find(patterns, world->threads, matches); }, world->plane);
+    }
+    sort(matches.begin(), matches.end(), [](const LifeMatch& a, const LifeMatch& b) {
+        return a.y != b.y ? a.y < b.y : a.x != b.x ? a.x < b.x : a.orientation < b.orientation;
+    });
+    if (fn) {
+        for (const LifeMatch& match : matches) fn(ctx, &match);
+    }
+    return static_cast<int64_t>(matches.size());
+}
+
+void life_snapshot(const LifeWorld* world, LifeRecordFn fn, void* ctx) {
+    if (world->topology != LIFE_PLANE) {
+        const DenseWorld& dense = world->dense;
+        for (int64_t y = 0; y < dense.height; y++) {
+            const uint64_t* row = dense.row(y) + 1;
+            if (all_of(row, row + dense.words, [](uint64_t word) { return word == 0; })) continue;
+            fn(ctx, LifeKey{0, y}, row, dense.words);
+        }
+        return;
+    }
+    
+    visit([&](auto& plane) {
+        plane.snapshot([&](const LifeKey& key, const uint64_t* bits, size_t words) { fn(ctx, key, bits, words); });
+    }, world->plane);
+}
+
+int64_t life_xor_record(LifeWorld* world, LifeKey key, const uint64_t* bits, size_t words) {
+    int64_t delta = 0;
+    if (world->topology != LIFE_PLANE) {
+        DenseWorld& dense = world->dense;
+        if (key.y < 0 || key.y >= dense.height) return 0;
+        uint64_t* row = dense.row(key.y) + 1;
+        for (size_t i = 0; i < min(words, dense.words); i++) {
+            delta -= __builtin_popcountll(row[i]);
+            row[i] ^= bits[i];
+            delta += __builtin_popcountll(row[i]);
+        }
+        dense.extent_stale = true;
+        world->population += delta;
+        world->dirty.push_back({0, 0});
+        return delta;
+    }
+    
+    delta = visit([&](auto& plane) { return plane.xor_record(key, bits, words); }, world->plane);
+    world->population += delta;
+    world->dirty.push_back(key);
+    return delta;
+}
+
+bool life_save(const LifeWorld* world, const char* filename, const char* header) {
+    ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    file << "#Life 1.06\n";
+    if (header) file << header;
+    
+    // 按块（固定尺寸世界按行）分批，每批由各线程格式化为文本后按顺序写出，输出顺序与 life_for_each_live 相同
+    const unsigned threads = world->threads;
+    vector<string> parts(threads);
+    auto write_batches = [&](size_t units, size_t unit_cells, auto&& format) {
+        size_t batch = threads * max<size_t>(1, SAVE_BATCH_CELLS / unit_cells);
+        for (size_t start = 0; start < units && file.good(); start += batch) {
+            for (string& part : parts) part.clear();
+            parallel_for(threads, min(batch, units - start), 1, [&](size_t begin, size_t end, size_t index) {
+                format(start + begin, start + end, parts[index]);
+            });
+            for (const string& part : parts) file.write(part.data(), static_cast<streamsize>(part.size()));
+        }
+    };
+    
+    if (world->topology != LIFE_PLANE) {
+        const DenseWorld& dense = world->dense;
+        write_batches(static_cast<size_t>(dense.height), static_cast<size_t>(dense.width),
+                      [&](size_t begin, size_t end, string& out) {
+            for_each_live_rows(dense, static_cast<int64_t>(begin), static_cast<int64_t>(end),
+                               [&](int64_t x, int64_t y) { append_cell(out, x, y); });
+        });
+    } else {
+        visit([&](auto& plane) {
+            write_batches(plane.chunks.size(), static_cast<size_t>(plane.SIZE) * plane.SIZE,
+                          [&](size_t begin, size_t end, string& out) {
+                plane.for_each_live(begin, end, [&](int64_t x, int64_t y) { append_cell(out, x, y); });
+            });
+        }, world->plane);
+    }
+    return file.good();
+}
+
+bool life_load(LifeWorld* world, const char* filename, LifeCommentFn on_comment, void* ctx) {
+    FileText text;
+    if (!text.open(filename)) {
+        return false;
+    }
+    
+    life_clear(world);
+    vector<pair<size_t, string>> comments;
+    size_t error = load_text(world, text.data, text.size, comments);
+    if (error != SIZE_MAX) {
+        // 格式错误：只保留错误行之前的细胞和注释
+        life_clear(world);
+        comments.clear();
+        load_text(world, text.data, error, comments);
+    }
+    if (on_comment) {
+        for (auto& comment : comments) on_comment(ctx, comment.second.c_str());
+    }
+    return error == SIZE_MAX;
+}
+
+void life_stats(const LifeWorld* world, LifeStats* stats) {
+    // 包围盒和坐标和由增量维护的摘要得出，不扫描细胞
+    Extent extent = world->topology != LIFE_PLANE
+        ? world->dense.current_extent()
+        : visit([](auto& plane) { return plane.extent(); }, world->plane);
+    
+    stats->population = world->population;
+    stats->chunks = world->topology == LIFE_PLANE
+        ? visit([](auto& plane) { return plane.chunks.size(); }, world->plane) : 0;
+    stats->min_x = extent.min_x;
+    stats->min_y = extent.min_y;
+    stats->max_x = extent.max_x;
+    stats->max_y = extent.max_y;
+    // 整数除法向零取整
+    stats->centroid_x = world->population ? static_cast<int64_t>(extent.sum_x / world->population) : 0;
+    stats->centroid_y = world->population ? static_cast<int64_t>(extent.sum_y / world->population) : 0;
+}
+
+}
@@ -0,0 +1,134 @@
+// LifeCore：生命游戏的模拟核心（世界存储、演算内核、文件读写、统计），C 接口，供 LifeGame.cpp 和 LifeGame.c 共用
+// 编译为静态库（在仓库根目录执行）：
+// g++ -O3 -c LifeCore/lifecore.cpp -o lifecore.o -pthread && ar rcs liblifecore.a lifecore.o              // 通用编译
+// g++ -O3 -DX64_OPTIMIZED -c LifeCore/lifecore.cpp -o lifecore.o -pthread && ar rcs liblifecore.a lifecore.o  // 64位优化（默认块宽度64）
+// g++ -O3 -DARM_OPTIMIZED -c LifeCore/lifecore.cpp -o lifecore.o -pthread && ar rcs liblifecore.a lifecore.o  // ARM（开启 NEON 时使用 NEON 内核）
+// 链接：C++ 前端加 -L. -llifecore -pthread，C 前端另加 -lstdc++
+
+#ifndef LIFECORE_H
+#define LIFECORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 不透明的世界句柄；同一个世界不能被多个线程同时调用
+typedef struct LifeWorld LifeWorld;
+
+typedef enum {
+    LIFE_PLANE,    // 无界平面，按块稀疏存储
+    LIFE_TORUS,    // 环面（上下左右相连）
+    LIFE_BOUNDED   // 有界平面（边界外恒为死细胞）
+} LifeTopology;
+
+// Larger-than-Life 规则的最大范围（须小于最小的块宽度）
+#define LIFE_MAX_RANGE 10
+
+// 查找图案的最大宽度和高度
+#define LIFE_MAX_FIND 1024
+
+// 块坐标；固定尺寸世界中 {0, y} 表示第 y 行
+typedef struct {
+    int64_t x, y;
+} LifeKey;
+
+typedef struct {
+    int64_t population;
+    size_t chunks;                       // 已分配的块数（固定尺寸世界为0）
+    int64_t min_x, min_y, max_x, max_y;  // 活细胞包围盒，population 为0时无意义
+    int64_t centroid_x, centroid_y;      // 活细胞重心（向零取整）
+} LifeStats;
+
+// 图案查找的一处匹配：包围盒左上角与尺寸，orientation 为 0..3（顺时针旋转 0/90/180/270 度）或 4..7（左右镜像后再旋转）
+typedef struct {
+    int64_t x, y;
+    int width, height;
+    int orientation;
+} LifeMatch;
+
+// 遍历活细胞
+typedef void (*LifeCellFn)(void *ctx, int64_t x, int64_t y);
+// 图案查找结果
+typedef void (*LifeMatchFn)(void *ctx, const LifeMatch *match);
+// 块/行记录：bits 为 words 个64位字（块位图或异或差分）
+typedef void (*LifeRecordFn)(void *ctx, LifeKey key, const uint64_t *bits, size_t words);
+// 区域批量操作：返回新的字，mask 为该字中落在区域内的位，base_x 为该字第0位的世界x坐标
+typedef uint64_t (*LifeWordFn)(void *ctx, uint64_t old, uint64_t mask, int64_t base_x, int64_t y);
+// 读取文件时的注释行（以 '#' 开头，不含换行）
+typedef void (*LifeCommentFn)(void *ctx, const char *line);
+
+LifeWorld *life_create(void);
+void life_destroy(LifeWorld *world);
+
+// 无界平面的块宽度：32/64/128/256，切换会清空世界
+bool life_set_chunk_size(LifeWorld *world, int size);
+int life_chunk_size(const LifeWorld *world);
+// 世界坐标 -> 块坐标（向下取整）
+int64_t life_chunk_coord(const LifeWorld *world, int64_t coord);
+
+// 切换拓扑会清空世界；LIFE_PLANE 忽略 width/height
+bool life_set_topology(LifeWorld *world, LifeTopology topology, int64_t width, int64_t height);
+LifeTopology life_topology(const LifeWorld *world);
+int64_t life_width(const LifeWorld *world);
+int64_t life_height(const LifeWorld *world);
+
+// 演算规则（默认 B3/S23），不清空世界；格式错误或含 B0 时返回 false，规则不变
+// B3/S23 形式：后缀 V 为冯·诺依曼邻域、H 为六边形邻域，如 B2/S34H
+// Larger-than-Life 形式：R5,C0,M1,S34..58,B34..45,NM（R 为范围 1..LIFE_MAX_RANGE，M1 表示计入细胞本身，N 后为 M/N/H）
+bool life_set_rule(LifeWorld *world, const char *rule);
+// 规范化后的规则字符串
+const char *life_rule(const LifeWorld *world);
+
+// 演算和读写文件的线程数（默认为CPU核数）
+void life_set_threads(LifeWorld *world, unsigned threads);
+unsigned life_threads(const LifeWorld *world);
+
+void life_clear(LifeWorld *world);
+bool life_get(LifeWorld *world, int64_t x, int64_t y);
+// 返回活细胞数的变化（-1/0/1）
+int life_set(LifeWorld *world, int64_t x, int64_t y, bool alive);
+int64_t life_population(const LifeWorld *world);
+
+// 演算一代，返回新的活细胞数；on_delta 非空时对每个变化的块/行回调与上一代的异或差分
+int64_t life_step(LifeWorld *world, LifeRecordFn on_delta, void *ctx);
+
+// 自上次 life_clear_dirty 以来变化过的块（可能重复）；固定尺寸世界只给出 {0, 0}，表示需要重绘整个视口
+const LifeKey *life_dirty(const LifeWorld *world, size_t *count);
+void life_clear_dirty(LifeWorld *world);
+
+void life_for_each_live(const LifeWorld *world, LifeCellFn fn, void *ctx);
+
+// 区域 [x0, x1) x [y0, y1) 按存储字批量操作，返回活细胞数的变化
+// create 为 false 时跳过不存在的块（清除、复制不需要分配新块）
+int64_t life_region(LifeWorld *world, int64_t x0, int64_t y0, int64_t x1, int64_t y1,
+                    bool create, LifeWordFn fn, void *ctx);
+
+// 查找图案在8个朝向下的所有出现：bits 为 height 行、每行 (width + 63) / 64 个字的位图（原点为左上角）
+// 取图案活细胞的包围盒，包围盒内活细胞和死细胞都相同才算匹配；对称图案的相同朝向只报告一次
+// 结果按 y、x 排序（环面中坐标在世界内）；图案为空或超过 LIFE_MAX_FIND 时返回 -1，否则返回匹配数
+int64_t life_find(const LifeWorld *world, const uint64_t *bits, int width, int height, LifeMatchFn fn, void *ctx);
+
+// 历史记录支持：完整快照（所有非空块/行），以及把一条记录异或进世界（返回活细胞数的变化）
+void life_snapshot(const LifeWorld *world, LifeRecordFn fn, void *ctx);
+int64_t life_xor_record(LifeWorld *world, LifeKey key, const uint64_t *bits, size_t words);
+
+// Life 1.06 文件：header 为写在坐标之前的注释行（可为 NULL，需自带换行）
+// 按块（固定尺寸世界按行）分批由各线程并行格式化，坐标顺序与 life_for_each_live 相同
+bool life_save(const LifeWorld *world, const char *filename, const char *header);
+// 读取前清空世界；文件按字节范围分给各线程并行解析，注释行在读完后按文件中的顺序回调
+// 格式错误时返回 false（错误行之前的细胞和注释保留）
+bool life_load(LifeWorld *world, const char *filename, LifeCommentFn on_comment, void *ctx);
+
+// 无界平面的统计由增量维护的占用摘要得出，不扫描细胞：查询时只计入变化过的块，其余为 O(log 块数)
+// 固定尺寸世界逐个编辑细胞时增量维护，演算或批量修改后的第一次查询重新扫描一遍
+void life_stats(const LifeWorld *world, LifeStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,70 +1,40 @@
 /*
 编译选项说明（支持 Android 环境）：
+模拟核心（世界存储、演算内核、文件读写）在 LifeCore 中，与 LifeGame.cpp 共用，需要先编译为 liblifecore.a。
+架构优化选项（-DARM_OPTIMIZED 等）和 -march/-mfpu 等指令集选项在编译核心时指定；
+ARM 配置在编译器开启 NEON 时使用 NEON 演算内核（未开启时自动退回标量实现），x86_64 配置配合 -mpopcnt 使用 popcnt 指令计数。
+PGO：核心和界面都加 -fprofile-generate（Clang 为 -fprofile-instr-generate）编译并运行一次，
+     再改为 -fprofile-use（Clang 先 llvm-profdata merge -output=default.profdata *.profraw，再用 -fprofile-instr-use=default.profdata）重新编译。
 
 1. 通用编译（无优化）：
-   gcc -o LifeGame LifeGame.c -lncurses -pthread -O2
+   g++ -O2 -c LifeCore/lifecore.cpp -o lifecore.o -pthread && ar rcs liblifecore.a lifecore.o
+   gcc -o LifeGame LifeGame.c -L. -llifecore -lstdc++ -lncurses -pthread -O2
 
 2. ARM32优化编译（Android 环境）：
-   # 基础编译（Android 环境）
+   g++ -marm -march=armv7-a -mtune=cortex-a53 -mfpu=neon -mfloat-abi=softfp \
+       -O3 -DARM_OPTIMIZED -c LifeCore/lifecore.cpp -o lifecore.o -pthread && ar rcs liblifecore.a lifecore.o
    gcc -marm -march=armv7-a -mtune=cortex-a53 -mfpu=neon -mfloat-abi=softfp \
-       -O3 -DARM_OPTIMIZED -o LifeGame_arm32 LifeGame.c -lncurses -pthread
-   
-   # Clang PGO优化（Android 环境）
-   clang -marm -march=armv7-a -mtune=cortex-a53 -mfpu=neon -mfloat-abi=softfp \
-         -fprofile-instr-generate -O3 -DARM_OPTIMIZED -o LifeGame_arm32_pgo LifeGame.c -lncurses -pthread
-   ./LifeGame_arm32_pgo
-   llvm-profdata merge -output=default.profdata *.profraw
-   clang -marm -march=armv7-a -mtune=cortex-a53 -mfpu=neon -mfloat-abi=softfp \
-         -fprofile-instr-use=default.profdata -O3 -DARM_OPTIMIZED -o LifeGame_arm32_optimized LifeGame.c -lncurses -pthread
-   
-   # GCC PGO优化（Android 环境）
-   gcc -marm -march=armv7-a -mtune=cortex-a53 -mfpu=neon -mfloat-abi=softfp \
-       -fprofile-generate -O3 -DARM_OPTIMIZED -o LifeGame_arm32_pgo LifeGame.c -lncurses -pthread
-   ./LifeGame_arm32_pgo
-   gcc -marm -march=armv7-a -mtune=cortex-a53 -mfpu=neon -mfloat-abi=softfp \
-       -fprofile-use -O3 -DARM_OPTIMIZED -o LifeGame_arm32_optimized LifeGame.c -lncurses -pthread
+       -O3 -o LifeGame_arm32 LifeGame.c -L. -llifecore -lstdc++ -lncurses -pthread
 
 3. ARM64优化编译（Android 环境）：
-   # 基础编译
-   gcc -O3 -DARM64_OPTIMIZED -o LifeGame_arm64 LifeGame.c -lncurses -pthread
-   
-   # Clang PGO优化
-   clang -O3 -DARM64_OPTIMIZED -march=armv8-a -mtune=cortex-a72 \
-         -fprofile-instr-generate -o LifeGame_arm64_pgo LifeGame.c -lncurses -pthread
-   ./LifeGame_arm64_pgo
-   llvm-profdata merge -output=default.profdata *.profraw
-   clang -O3 -DARM64_OPTIMIZED -march=armv8-a -mtune=cortex-a72 \
-         -fprofile-instr-use=default.profdata -o LifeGame_arm64_optimized LifeGame.c -lncurses -pthread
-   
-   # GCC PGO优化
-   gcc -O3 -DARM64_OPTIMIZED -march=armv8-a -mtune=cortex-a72 \
-       -fprofile-generate -o LifeGame_arm64_pgo LifeGame.c -lncurses -pthread
-   ./LifeGame_arm64_pgo
-   gcc -O3 -DARM64_OPTIMIZED -march=armv8-a -mtune=cortex-a72 \
-       -fprofile-use -o LifeGame_arm64_optimized LifeGame.c -lncurses -pthread
+   g++ -O3 -DARM64_OPTIMIZED -march=armv8-a -mtune=cortex-a72 \
+       -c LifeCore/lifecore.cpp -o lifecore.o -pthread && ar rcs liblifecore.a lifecore.o
+   gcc -O3 -march=armv8-a -mtune=cortex-a72 -o LifeGame_arm64 LifeGame.c -L. -llifecore -lstdc++ -lncurses -pthread
    
-   # 针对树莓派4（Cortex-A72）
-   gcc -O3 -DARM64_OPTIMIZED -mcpu=cortex-a72 -o LifeGame_rpi4 LifeGame.c -lncurses -pthread
+   # 针对树莓派4（Cortex-A72）：两条命令都改用 -mcpu=cortex-a72
 
 4. x86_64优化编译（通用 Linux 环境）：
-   # 基础编译
-   gcc -m64 -march=x86-64 -mtune=znver3 -O3 -DX64_OPTIMIZED \
-       -o LifeGame_x64 LifeGame.c -lncurses -pthread
-   
-   # PGO优化（GCC）
-   gcc -m64 -march=haswell -flto -fprofile-generate -O3 -DX64_OPTIMIZED -mpopcnt \
-       -o LifeGame_x64_pgo LifeGame.c -lncurses -pthread
-   ./LifeGame_x64_pgo
-   gcc -m64 -march=haswell -flto -fprofile-use -fprofile-correction -O3 -DX64_OPTIMIZED -mpopcnt \
-       -o LifeGame_x64_optimized LifeGame.c -lncurses -pthread
-   
-   # PGO优化（Clang）
-   clang -m64 -march=haswell -flto -fprofile-instr-generate -O3 -DX64_OPTIMIZED -mpopcnt \
-         -o LifeGame_x64_pgo LifeGame.c -lncurses -pthread
-   ./LifeGame_x64_pgo
-   llvm-profdata merge -output=default.profdata *.profraw
-   clang -m64 -march=haswell -flto -fprofile-instr-use=default.profdata -O3 -DX64_OPTIMIZED -mpopcnt \
-         -o LifeGame_x64_optimized LifeGame.c -lncurses -pthread
+   g++ -m64 -march=haswell -O3 -DX64_OPTIMIZED -mpopcnt \
+       -c LifeCore/lifecore.cpp -o lifecore.o -pthread && ar rcs liblifecore.a lifecore.o
+   gcc -m64 -march=haswell -O3 -o LifeGame_x64 LifeGame.c -L. -llifecore -lstdc++ -lncurses -pthread
+
+5. 运行参数：
+   ./LifeGame -k 128       # 块宽度：32/64/128/256（默认由编译核心时的配置决定）
+   ./LifeGame -j 4         # 演算线程数（默认为CPU核数）
+   ./LifeGame -r B2/S34H   # 演算规则（默认 B3/S23），也可用 Larger-than-Life 形式：-r R5,C0,M1,S34..58,B34..45,NM
+
+6. 无界面基准测试（与 LifeGame.cpp 的 --bench 使用同一个核心、同样的输出格式，可用同一个图案文件对比）：
+   ./LifeGame [-k 宽度] [-j 线程数] [-r 规则] --bench [代数] [文件]
 */
 
 #define _XOPEN_SOURCE 700
@@ -77,52 +47,15 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <limits.h>
-#include <sys/queue.h>
 #include <sys/time.h>
 #include <stdbool.h>
-#include <arm_neon.h>
+#include "LifeCore/lifecore.h"
 
 // 速度等级定义
 #define MIN_SPEED_LEVEL 1
 #define MAX_SPEED_LEVEL 10
 #define DEFAULT_SPEED_LEVEL 5
 
-// 根据架构选择优化配置
-#if defined(ARM_OPTIMIZED)
-    // ARM32优化配置
-    #define CHUNK_SIZE 32
-    typedef uint32_t BitmapType;
-    #define BITS_PER_UNIT 32
-    #define BITMAP_SIZE ((CHUNK_SIZE * CHUNK_SIZE + BITS_PER_UNIT - 1) / BITS_PER_UNIT)
-#elif defined(ARM64_OPTIMIZED)
-    // ARM64优化配置
-    #define CHUNK_SIZE 64
-    typedef uint64_t BitmapType;
-    #define BITS_PER_UNIT 64
-    #define BITMAP_SIZE ((CHUNK_SIZE * CHUNK_SIZE + BITS_PER_UNIT - 1) / BITS_PER_UNIT)
-    #define NEON_OPTIMIZATION 1
-#elif defined(X64_OPTIMIZED)
-    // x86_64优化配置
-    #define CHUNK_SIZE 64
-    typedef uint64_t BitmapType;
-    #define BITS_PER_UNIT 64
-    #define BITMAP_SIZE ((CHUNK_SIZE * CHUNK_SIZE + BITS_PER_UNIT - 1) / BITS_PER_UNIT)
-    #define POPCNT_OPTIMIZATION 1
-#else
-    // 通用配置
-    #define CHUNK_SIZE 32
-    typedef uint32_t BitmapType;
-    #define BITS_PER_UNIT 32
-    #define BITMAP_SIZE ((CHUNK_SIZE * CHUNK_SIZE + BITS_PER_UNIT - 1) / BITS_PER_UNIT)
-#endif
-
-// 优化邻居计算
-static const int neighbor_offsets[8][2] = {
-    {-1, -1}, {0, -1}, {1, -1},
-    {-1,  0},           {1,  0},
-    {-1,  1}, {0,  1}, {1,  1}
-};
-
 // 模式枚举
 typedef enum {
     DESIGN,
@@ -137,50 +70,11 @@ typedef enum {
     CANCEL
 } CommandResult;
 
-// 块结构
-typedef struct Chunk {
-    BitmapType bitmap[BITMAP_SIZE];
-    bool dirty;
-    int live_count;
-} Chunk;
-
-// 坐标对
-typedef struct {
-    int first;
-    int second;
-} Pair;
-
-// 更新三元组
-typedef struct {
-    int x;
-    int y;
-    bool alive;
-} Update;
-
-// 哈希表条目
-typedef struct ChunkEntry {
-    int key;
-    Chunk *chunk;
-    SLIST_ENTRY(ChunkEntry) entries;
-} ChunkEntry;
-
-// 行哈希表
-typedef SLIST_HEAD(ChunkHead, ChunkEntry) ChunkRow;
-typedef struct RowEntry {
-    int key;
-    ChunkRow row;
-    SLIST_ENTRY(RowEntry) entries;
-} RowEntry;
-
-// 世界哈希表
-typedef SLIST_HEAD(WorldHead, RowEntry) World;
-
 // 游戏状态结构
 typedef struct {
     Mode mode;
     int rows, cols;
-    World world;
-    int live_cell_count;
+    LifeWorld *world;         // 模拟核心（见 LifeCore/lifecore.h）
     int viewport_x;
     int viewport_y;
     int cursor_screen_x;
@@ -193,15 +87,6 @@ typedef struct {
     bool precompute;
     int precompute_rounds;
     bool running;
-    Pair *dirty_chunks;
-    int dirty_count;
-    int dirty_capacity;
-    Pair *positions_to_check;
-    int positions_count;
-    int positions_capacity;
-    Update *updates;
-    int updates_count;
-    int updates_capacity;
     int prev_rows, prev_cols; // 保存上一次的终端尺寸
     int speed_level;          // 速度等级 (1-10)
     int skip_frames;          // 跳过的帧数（用于高速模式）
@@ -210,27 +95,22 @@ typedef struct {
 // 函数声明
 void init_game(GameState *state, int argc, char** argv);
 void free_game(GameState *state);
-Chunk* get_chunk_if_exists(GameState *state, int world_x, int world_y);
-Chunk* get_chunk(GameState *state, int world_x, int world_y);
 bool peek_cell(GameState *state, int world_x, int world_y);
 void set_cell(GameState *state, int world_x, int world_y, bool alive);
 void compute_generation(GameState *state);
 void show_loading(GameState *state);
-void draw_chunk(GameState *state, int chunk_x, int chunk_y, Chunk *chunk);
+void draw_chunk(GameState *state, LifeKey key);
 void draw_cursor(GameState *state);
 void draw_all_visible_chunks(GameState *state);
+void draw_dirty_chunks(GameState *state);
 CommandResult save_world(GameState *state, const char* filename);
 CommandResult load_world(GameState *state, const char* filename);
 void design_mode(GameState *state);
 void command_mode(GameState *state);
 void play_mode(GameState *state);
-void resize_array(void **array, int *capacity, int count, size_t element_size);
-void add_to_dirty_chunks(GameState *state, int chunk_x, int chunk_y);
-void add_to_positions(GameState *state, int x, int y);
-void add_to_updates(GameState *state, int x, int y, bool alive);
-void free_world(World *world);
 uint64_t get_time_ms();
 void adjust_speed(GameState *state, int change);
+bool parse_core_option(GameState *state, int argc, char** argv, int *i);
 
 // 获取当前时间（毫秒）
 uint64_t get_time_ms() {
@@ -251,68 +131,30 @@ void adjust_speed(GameState *state, int change) {
     state->skip_frames = 0;
 }
 
-// 调整动态数组大小
-void resize_array(void **array, int *capacity, int count, size_t element_size) {
-    if (count >= *capacity) {
-        int new_capacity = *capacity == 0 ? 64 : *capacity * 2;
-        void *new_array = realloc(*array, new_capacity * element_size);
-        if (!new_array) return;
-        *array = new_array;
-        *capacity = new_capacity;
+// 解析核心参数 -k/-j/-r（界面和基准测试共用），识别时跳过参数值并返回 true
+bool parse_core_option(GameState *state, int argc, char** argv, int *i) {
+    if (*i + 1 >= argc) return false;
+    
+    if (strcmp(argv[*i], "-r") == 0) {
+        if (!life_set_rule(state->world, argv[*i + 1])) return false;
+        (*i)++;
+        return true;
     }
-}
-
-// 添加脏块
-void add_to_dirty_chunks(GameState *state, int chunk_x, int chunk_y) {
-    resize_array((void**)&state->dirty_chunks, &state->dirty_capacity, state->dirty_count, sizeof(Pair));
-    state->dirty_chunks[state->dirty_count].first = chunk_x;
-    state->dirty_chunks[state->dirty_count].second = chunk_y;
-    state->dirty_count++;
-}
-
-// 添加位置
-void add_to_positions(GameState *state, int x, int y) {
-    resize_array((void**)&state->positions_to_check, &state->positions_capacity, state->positions_count, sizeof(Pair));
-    state->positions_to_check[state->positions_count].first = x;
-    state->positions_to_check[state->positions_count].second = y;
-    state->positions_count++;
-}
-
-// 添加更新
-void add_to_updates(GameState *state, int x, int y, bool alive) {
-    resize_array((void**)&state->updates, &state->updates_capacity, state->updates_count, sizeof(Update));
-    state->updates[state->updates_count].x = x;
-    state->updates[state->updates_count].y = y;
-    state->updates[state->updates_count].alive = alive;
-    state->updates_count++;
-}
-
-// 块操作：获取位值
-bool chunk_get_bit(const Chunk *chunk, int x, int y) {
-    int64_t pos = (int64_t)y * CHUNK_SIZE + x;
-    if (pos < 0 || pos >= CHUNK_SIZE * CHUNK_SIZE) return false;
-    size_t idx = (size_t)pos / BITS_PER_UNIT;
-    return (chunk->bitmap[idx] >> (pos % BITS_PER_UNIT)) & 1;
-}
-
-// 块操作：设置位值
-void chunk_set_bit(Chunk *chunk, int x, int y, bool value) {
-    int64_t pos = (int64_t)y * CHUNK_SIZE + x;
-    if (pos < 0 || pos >= CHUNK_SIZE * CHUNK_SIZE) return;
-    size_t idx = (size_t)pos / BITS_PER_UNIT;
-    BitmapType mask = (BitmapType)1 << (pos % BITS_PER_UNIT);
     
-    bool current = (chunk->bitmap[idx] & mask) != 0;
-    if (current == value) return;
+    char *end;
+    long value = strtol(argv[*i + 1], &end, 10);
+    if (*end != '\0') return false;
     
-    if (value) {
-        chunk->bitmap[idx] |= mask;
-        chunk->live_count++;
-    } else {
-        chunk->bitmap[idx] &= ~mask;
-        chunk->live_count--;
+    if (strcmp(argv[*i], "-k") == 0 && life_set_chunk_size(state->world, value)) {
+        (*i)++;
+        return true;
     }
-    chunk->dirty = true;
+    if (strcmp(argv[*i], "-j") == 0 && value > 0 && value <= 256) {
+        life_set_threads(state->world, value);
+        (*i)++;
+        return true;
+    }
+    return false;
 }
 
 // 初始化游戏
@@ -327,7 +169,7 @@ void init_game(GameState *state, int argc, char** argv) {
     state->prev_cursor_screen_y = -1;
     state->speed_level = DEFAULT_SPEED_LEVEL;
     state->skip_frames = 0;
-    SLIST_INIT(&state->world);
+    state->world = life_create();
     state->prev_rows = LINES;
     state->prev_cols = COLS;
     
@@ -354,245 +196,31 @@ void init_game(GameState *state, int argc, char** argv) {
                 }
             }
         }
+        else {
+            parse_core_option(state, argc, argv, &i);
+        }
     }
 }
 
 // 释放游戏资源
 void free_game(GameState *state) {
-    free_world(&state->world);
-    free(state->dirty_chunks);
-    free(state->positions_to_check);
-    free(state->updates);
+    life_destroy(state->world);
     if (state->command_str) free(state->command_str);
 }
 
-// 释放世界资源
-void free_world(World *world) {
-    RowEntry *row_entry;
-    while (!SLIST_EMPTY(world)) {
-        row_entry = SLIST_FIRST(world);
-        ChunkEntry *chunk_entry;
-        while (!SLIST_EMPTY(&row_entry->row)) {
-            chunk_entry = SLIST_FIRST(&row_entry->row);
-            SLIST_REMOVE_HEAD(&row_entry->row, entries);
-            free(chunk_entry->chunk);
-            free(chunk_entry);
-        }
-        SLIST_REMOVE(world, row_entry, RowEntry, entries);
-        free(row_entry);
-    }
-}
-
-// 获取块（如果存在）
-Chunk* get_chunk_if_exists(GameState *state, int world_x, int world_y) {
-    if (world_x < INT_MIN/2 || world_x > INT_MAX/2 || 
-        world_y < INT_MIN/2 || world_y > INT_MAX/2) {
-        return NULL;
-    }
-    
-    int chunk_x = world_x / CHUNK_SIZE;
-    int chunk_y = world_y / CHUNK_SIZE;
-    
-    RowEntry *row_entry;
-    SLIST_FOREACH(row_entry, &state->world, entries) {
-        if (row_entry->key == chunk_y) {
-            ChunkEntry *chunk_entry;
-            SLIST_FOREACH(chunk_entry, &row_entry->row, entries) {
-                if (chunk_entry->key == chunk_x) {
-                    return chunk_entry->chunk;
-                }
-            }
-            return NULL;
-        }
-    }
-    return NULL;
-}
-
-// 获取或创建块
-Chunk* get_chunk(GameState *state, int world_x, int world_y) {
-    if (world_x < INT_MIN/2 || world_x > INT_MAX/2 || 
-        world_y < INT_MIN/2 || world_y > INT_MAX/2) {
-        return NULL;
-    }
-    
-    int chunk_x = world_x / CHUNK_SIZE;
-    int chunk_y = world_y / CHUNK_SIZE;
-    
-    RowEntry *row_entry;
-    SLIST_FOREACH(row_entry, &state->world, entries) {
-        if (row_entry->key == chunk_y) {
-            ChunkEntry *chunk_entry;
-            SLIST_FOREACH(chunk_entry, &row_entry->row, entries) {
-                if (chunk_entry->key == chunk_x) {
-                    return chunk_entry->chunk;
-                }
-            }
-            ChunkEntry *new_entry = malloc(sizeof(ChunkEntry));
-            if (!new_entry) return NULL;
-            new_entry->key = chunk_x;
-            new_entry->chunk = calloc(1, sizeof(Chunk));
-            if (!new_entry->chunk) {
-                free(new_entry);
-                return NULL;
-            }
-            SLIST_INSERT_HEAD(&row_entry->row, new_entry, entries);
-            return new_entry->chunk;
-        }
-    }
-    RowEntry *new_row = malloc(sizeof(RowEntry));
-    if (!new_row) return NULL;
-    new_row->key = chunk_y;
-    SLIST_INIT(&new_row->row);
-    
-    ChunkEntry *new_entry = malloc(sizeof(ChunkEntry));
-    if (!new_entry) {
-        free(new_row);
-        return NULL;
-    }
-    new_entry->key = chunk_x;
-    new_entry->chunk = calloc(1, sizeof(Chunk));
-    if (!new_entry->chunk) {
-        free(new_entry);
-        free(new_row);
-        return NULL;
-    }
-    SLIST_INSERT_HEAD(&new_row->row, new_entry, entries);
-    SLIST_INSERT_HEAD(&state->world, new_row, entries);
-    return new_entry->chunk;
-}
-
 // 查看细胞状态
 bool peek_cell(GameState *state, int world_x, int world_y) {
-    if (world_x < INT_MIN + CHUNK_SIZE || world_x > INT_MAX - CHUNK_SIZE ||
-        world_y < INT_MIN + CHUNK_SIZE || world_y > INT_MAX - CHUNK_SIZE) {
-        return false;
-    }
-    
-    Chunk *chunk = get_chunk_if_exists(state, world_x, world_y);
-    if (!chunk) return false;
-    
-    int local_x = world_x % CHUNK_SIZE;
-    int local_y = world_y % CHUNK_SIZE;
-    
-    if (local_x < 0) local_x += CHUNK_SIZE;
-    if (local_y < 0) local_y += CHUNK_SIZE;
-    
-    return chunk_get_bit(chunk, local_x, local_y);
+    return life_get(state->world, world_x, world_y);
 }
 
 // 设置细胞状态
 void set_cell(GameState *state, int world_x, int world_y, bool alive) {
-    if (world_x < INT_MIN/2 || world_x > INT_MAX/2 || 
-        world_y < INT_MIN/2 || world_y > INT_MAX/2) {
-        return;
-    }
-    
-    Chunk *chunk = get_chunk(state, world_x, world_y);
-    if (!chunk) return;
-    
-    int local_x = world_x % CHUNK_SIZE;
-    int local_y = world_y % CHUNK_SIZE;
-    
-    if (local_x < 0) local_x += CHUNK_SIZE;
-    if (local_y < 0) local_y += CHUNK_SIZE;
-    
-    bool current = chunk_get_bit(chunk, local_x, local_y);
-    if (current != alive) {
-        chunk_set_bit(chunk, local_x, local_y, alive);
-        
-        if (alive) state->live_cell_count++;
-        else state->live_cell_count--;
-        
-        int chunk_x = world_x / CHUNK_SIZE;
-        int chunk_y = world_y / CHUNK_SIZE;
-        add_to_dirty_chunks(state, chunk_x, chunk_y);
-    }
+    life_set(state->world, world_x, world_y, alive);
 }
 
-// 比较函数
-int pair_compare(const void *a, const void *b) {
-    const Pair *pa = (const Pair*)a;
-    const Pair *pb = (const Pair*)b;
-    if (pa->first != pb->first) return pa->first - pb->first;
-    return pa->second - pb->second;
-}
-
-// 计算下一代
+// 计算下一代（演算内核在 LifeCore 中）
 void compute_generation(GameState *state) {
-    if (state->live_cell_count == 0) return;
-    
-    state->positions_count = 0;
-    state->updates_count = 0;
-    
-    RowEntry *row_entry;
-    SLIST_FOREACH(row_entry, &state->world, entries) {
-        ChunkEntry *chunk_entry;
-        SLIST_FOREACH(chunk_entry, &row_entry->row, entries) {
-            Chunk *chunk = chunk_entry->chunk;
-            if (!chunk || chunk->live_count == 0) continue;
-            
-            int world_base_x = chunk_entry->key * CHUNK_SIZE;
-            int world_base_y = row_entry->key * CHUNK_SIZE;
-            
-            for (int y = 0; y < CHUNK_SIZE; y++) {
-                for (int x = 0; x < CHUNK_SIZE; x++) {
-                    if (!chunk_get_bit(chunk, x, y)) continue;
-                    
-                    int world_x = world_base_x + x;
-                    int world_y = world_base_y + y;
-                    
-                    for (int i = 0; i < 8; i++) {
-                        int nx = world_x + neighbor_offsets[i][0];
-                        int ny = world_y + neighbor_offsets[i][1];
-                        add_to_positions(state, nx, ny);
-                    }
-                    add_to_positions(state, world_x, world_y);
-                }
-            }
-        }
-    }
-    
-    if (state->positions_count == 0) return;
-    qsort(state->positions_to_check, state->positions_count, sizeof(Pair), pair_compare);
-    
-    int unique_count = 0;
-    for (int i = 0; i < state->positions_count; i++) {
-        if (i == 0 || 
-            state->positions_to_check[i].first != state->positions_to_check[i-1].first ||
-            state->positions_to_check[i].second != state->positions_to_check[i-1].second) {
-            state->positions_to_check[unique_count++] = state->positions_to_check[i];
-        }
-    }
-    state->positions_count = unique_count;
-    
-    for (int i = 0; i < state->positions_count; i++) {
-        int world_x = state->positions_to_check[i].first;
-        int world_y = state->positions_to_check[i].second;
-        int neighbors = 0;
-        
-        for (int j = 0; j < 8; j++) {
-            int nx = world_x + neighbor_offsets[j][0];
-            int ny = world_y + neighbor_offsets[j][1];
-            if (peek_cell(state, nx, ny)) {
-                neighbors++;
-            }
-        }
-        
-        bool current = peek_cell(state, world_x, world_y);
-        if (current) {
-            if (neighbors < 2 || neighbors > 3) {
-                add_to_updates(state, world_x, world_y, false);
-            }
-        } else {
-            if (neighbors == 3) {
-                add_to_updates(state, world_x, world_y, true);
-            }
-        }
-    }
-    
-    for (int i = 0; i < state->updates_count; i++) {
-        set_cell(state, state->updates[i].x, state->updates[i].y, state->updates[i].alive);
-    }
+    life_step(state->world, NULL, NULL);
 }
 
 // 显示加载进度
@@ -641,29 +269,27 @@ void show_loading(GameState *state) {
     refresh();
 }
 
-// 绘制块
-void draw_chunk(GameState *state, int chunk_x, int chunk_y, Chunk *chunk) {
-    int world_start_x = chunk_x * CHUNK_SIZE;
-    int world_start_y = chunk_y * CHUNK_SIZE;
+// 绘制块与屏幕相交的部分（演算中被释放的块没有活细胞，按空块绘制）
+void draw_chunk(GameState *state, LifeKey key) {
+    int size = life_chunk_size(state->world);
+    long long world_start_x = key.x * size;
+    long long world_start_y = key.y * size;
     
-    for (int y = 0; y < CHUNK_SIZE; y++) {
-        for (int x = 0; x < CHUNK_SIZE; x++) {
-            int screen_x = world_start_x + x - state->viewport_x;
-            int screen_y = world_start_y + y - state->viewport_y;
+    for (int y = 0; y < size; y++) {
+        long long screen_y = world_start_y + y - state->viewport_y;
+        if (screen_y < 0 || screen_y >= state->rows) continue;
+        
+        for (int x = 0; x < size; x++) {
+            long long screen_x = world_start_x + x - state->viewport_x;
+            if (screen_x < 0 || screen_x >= state->cols) continue;
             
-            if (screen_x >= 0 && screen_x < state->cols && 
-                screen_y >= 0 && screen_y < state->rows) {
-                
-                if (chunk_get_bit(chunk, x, y)) {
-                    mvaddch(screen_y, screen_x, '#' | A_BOLD);
-                } else {
-                    mvaddch(screen_y, screen_x, ' ');
-                }
+            if (life_get(state->world, world_start_x + x, world_start_y + y)) {
+                mvaddch(screen_y, screen_x, '#' | A_BOLD);
+            } else {
+                mvaddch(screen_y, screen_x, ' ');
             }
         }
     }
-    
-    chunk->dirty = false;
 }
 
 // 绘制光标
@@ -698,145 +324,76 @@ void draw_cursor(GameState *state) {
 
 // 绘制所有可见块
 void draw_all_visible_chunks(GameState *state) {
-    int min_world_x = state->viewport_x;
-    int min_world_y = state->viewport_y;
-    int max_world_x = state->viewport_x + state->cols;
-    int max_world_y = state->viewport_y + state->rows;
-    
-    int min_chunk_x = min_world_x / CHUNK_SIZE;
-    int min_chunk_y = min_world_y / CHUNK_SIZE;
-    int max_chunk_x = (max_world_x + CHUNK_SIZE - 1) / CHUNK_SIZE;
-    int max_chunk_y = (max_world_y + CHUNK_SIZE - 1) / CHUNK_SIZE;
-    
-    for (int chunk_y = min_chunk_y; chunk_y <= max_chunk_y; chunk_y++) {
-        RowEntry *row_entry = NULL;
-        SLIST_FOREACH(row_entry, &state->world, entries) {
-            if (row_entry->key == chunk_y) {
-                for (int chunk_x = min_chunk_x; chunk_x <= max_chunk_x; chunk_x++) {
-                    ChunkEntry *chunk_entry;
-                    SLIST_FOREACH(chunk_entry, &row_entry->row, entries) {
-                        if (chunk_entry->key == chunk_x) {
-                            draw_chunk(state, chunk_x, chunk_y, chunk_entry->chunk);
-                        }
-                    }
-                }
-            }
+    int64_t min_chunk_x = life_chunk_coord(state->world, state->viewport_x);
+    int64_t min_chunk_y = life_chunk_coord(state->world, state->viewport_y);
+    int64_t max_chunk_x = life_chunk_coord(state->world, state->viewport_x + state->cols - 1);
+    int64_t max_chunk_y = life_chunk_coord(state->world, state->viewport_y + state->rows - 1);
+    
+    for (int64_t chunk_y = min_chunk_y; chunk_y <= max_chunk_y; chunk_y++) {
+        for (int64_t chunk_x = min_chunk_x; chunk_x <= max_chunk_x; chunk_x++) {
+            LifeKey key = {chunk_x, chunk_y};
+            draw_chunk(state, key);
         }
     }
 }
 
-// 保存世界状态
-CommandResult save_world(GameState *state, const char* filename) {
-    FILE *file = fopen(filename, "w");
-    if (!file) {
-        return ERROR;
+// 只重绘变化过的块
+void draw_dirty_chunks(GameState *state) {
+    size_t count;
+    const LifeKey *dirty = life_dirty(state->world, &count);
+    for (size_t i = 0; i < count; i++) {
+        draw_chunk(state, dirty[i]);
     }
+    life_clear_dirty(state->world);
+}
 
-    fprintf(file, "#Life 1.06\n");
-    fprintf(file, "# Generated by LifeGame\n");
-    fprintf(file, "# Viewport: %d %d\n", state->viewport_x, state->viewport_y);
-    fprintf(file, "# Speed: %d\n", state->speed_level);
+// 保存世界状态
+CommandResult save_world(GameState *state, const char* filename) {
+    char header[128];
+    snprintf(header, sizeof(header), "# Generated by LifeGame\n# Viewport: %d %d\n# Speed: %d\n",
+             state->viewport_x, state->viewport_y, state->speed_level);
+    
+    return life_save(state->world, filename, header) ? SUCCESS : ERROR;
+}
 
-    RowEntry *row_entry;
-    SLIST_FOREACH(row_entry, &state->world, entries) {
-        ChunkEntry *chunk_entry;
-        SLIST_FOREACH(chunk_entry, &row_entry->row, entries) {
-            Chunk *chunk = chunk_entry->chunk;
-            if (!chunk || chunk->live_count == 0) continue;
-            
-            int world_base_x = chunk_entry->key * CHUNK_SIZE;
-            int world_base_y = row_entry->key * CHUNK_SIZE;
-            
-            for (int y = 0; y < CHUNK_SIZE; y++) {
-                for (int x = 0; x < CHUNK_SIZE; x++) {
-                    if (chunk_get_bit(chunk, x, y)) {
-                        fprintf(file, "%d %d\n", world_base_x + x, world_base_y + y);
-                    }
-                }
-            }
+// 读取文件时从注释行中取出的视口和速度
+typedef struct {
+    GameState *state;
+    bool viewport_loaded;
+    bool speed_loaded;
+} LoadInfo;
+
+static void read_load_comment(void *ctx, const char *line) {
+    LoadInfo *info = ctx;
+    if (strstr(line, "# Viewport:") != NULL) {
+        if (sscanf(line + 11, "%d %d", &info->state->viewport_x, &info->state->viewport_y) == 2) {
+            info->viewport_loaded = true;
+        }
+    }
+    else if (strstr(line, "# Speed:") != NULL) {
+        if (sscanf(line + 8, "%d", &info->state->speed_level) == 1) {
+            info->speed_loaded = true;
         }
     }
-
-    fclose(file);
-    return SUCCESS;
 }
 
 // 加载世界状态
 CommandResult load_world(GameState *state, const char* filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
+    LoadInfo info = {state, false, false};
+    if (!life_load(state->world, filename, read_load_comment, &info)) {
         return ERROR;
     }
-
-    free_world(&state->world);
-    SLIST_INIT(&state->world);
-    state->live_cell_count = 0;
-
-    char line[256];
-    bool viewport_loaded = false;
-    bool speed_loaded = false;
-
-    while (fgets(line, sizeof(line), file)) {
-        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
-            if (strstr(line, "# Viewport:") != NULL) {
-                if (sscanf(line + 11, "%d %d", &state->viewport_x, &state->viewport_y) == 2) {
-                    viewport_loaded = true;
-                }
-            }
-            else if (strstr(line, "# Speed:") != NULL) {
-                if (sscanf(line + 8, "%d", &state->speed_level) == 1) {
-                    speed_loaded = true;
-                }
-            }
-            continue;
-        }
-
-        int x, y;
-        if (sscanf(line, "%d %d", &x, &y) == 2) {
-            set_cell(state, x, y, true);
-        } else {
-            fclose(file);
-            return ERROR;
-        }
-    }
-
-    fclose(file);
     
     // 如果没有加载速度，使用默认速度
-    if (!speed_loaded) {
+    if (!info.speed_loaded || state->speed_level < MIN_SPEED_LEVEL || state->speed_level > MAX_SPEED_LEVEL) {
         state->speed_level = DEFAULT_SPEED_LEVEL;
     }
     
-    if (!viewport_loaded && state->live_cell_count > 0) {
-        long long sum_x = 0, sum_y = 0;
-        int count = 0;
-        
-        RowEntry *row_entry;
-        SLIST_FOREACH(row_entry, &state->world, entries) {
-            ChunkEntry *chunk_entry;
-            SLIST_FOREACH(chunk_entry, &row_entry->row, entries) {
-                Chunk *chunk = chunk_entry->chunk;
-                if (!chunk || chunk->live_count == 0) continue;
-                
-                int world_base_x = chunk_entry->key * CHUNK_SIZE;
-                int world_base_y = row_entry->key * CHUNK_SIZE;
-                
-                for (int y = 0; y < CHUNK_SIZE; y++) {
-                    for (int x = 0; x < CHUNK_SIZE; x++) {
-                        if (chunk_get_bit(chunk, x, y)) {
-                            sum_x += world_base_x + x;
-                            sum_y += world_base_y + y;
-                            count++;
-                        }
-                    }
-                }
-            }
-        }
-        
-        if (count > 0) {
-            state->viewport_x = (int)(sum_x / count) - state->cols / 2;
-            state->viewport_y = (int)(sum_y / count) - state->rows / 2;
-        }
+    if (!info.viewport_loaded && life_population(state->world) > 0) {
+        LifeStats stats;
+        life_stats(state->world, &stats);
+        state->viewport_x = (int)stats.centroid_x - state->cols / 2;
+        state->viewport_y = (int)stats.centroid_y - state->rows / 2;
     }
     
     state->need_full_refresh = true;
@@ -846,7 +403,7 @@ CommandResult load_world(GameState *state, const char* filename) {
 // 设计模式
 void design_mode(GameState *state) {
     curs_set(1);
-    state->dirty_count = 0;
+    life_clear_dirty(state->world);
     state->prev_cursor_screen_x = state->cursor_screen_x;
     state->prev_cursor_screen_y = state->cursor_screen_y;
     
@@ -875,24 +432,15 @@ void design_mode(GameState *state) {
             draw_all_visible_chunks(state);
             state->viewport_changed = false;
             state->need_full_refresh = false;
-            state->dirty_count = 0;
+            life_clear_dirty(state->world);
         } else {
-            for (int i = 0; i < state->dirty_count; i++) {
-                int chunk_x = state->dirty_chunks[i].first;
-                int chunk_y = state->dirty_chunks[i].second;
-                Chunk *chunk = get_chunk_if_exists(state, 
-                    chunk_x * CHUNK_SIZE, chunk_y * CHUNK_SIZE);
-                if (chunk) {
-                    draw_chunk(state, chunk_x, chunk_y, chunk);
-                }
-            }
-            state->dirty_count = 0;
+            draw_dirty_chunks(state);
         }
         
         draw_cursor(state);
         
-        mvprintw(0, 0, "DESIGN MODE - Cells: %d | Cursor: (%d, %d) | Viewport: (%d, %d)", 
-                 state->live_cell_count, 
+        mvprintw(0, 0, "DESIGN MODE - Cells: %lld | Cursor: (%d, %d) | Viewport: (%d, %d)", 
+                 (long long)life_population(state->world), 
                  state->cursor_screen_x + state->viewport_x, 
                  state->cursor_screen_y + state->viewport_y,
                  state->viewport_x, state->viewport_y);
@@ -1016,9 +564,7 @@ void command_mode(GameState *state) {
                         sleep(1);
                     }
                     else if (strcmp(cmd, "clear") == 0 || strcmp(cmd, "CLEAR") == 0) {
-                        free_world(&state->world);
-                        SLIST_INIT(&state->world);
-                        state->live_cell_count = 0;
+                        life_clear(state->world);
                         state->need_full_refresh = true;
                         move(state->rows - 2, 0);
                         clrtoeol();
@@ -1092,7 +638,7 @@ void command_mode(GameState *state) {
 void play_mode(GameState *state) {
     curs_set(0);
     nodelay(stdscr, TRUE);
-    state->dirty_count = 0;
+    life_clear_dirty(state->world);
     
     int generation_count = 0;
     uint64_t last_frame_time = get_time_ms();
@@ -1127,7 +673,7 @@ void play_mode(GameState *state) {
         last_frame_time = current_time;
         
         // 计算下一代
-        if (state->live_cell_count > 0) {
+        if (life_population(state->world) > 0) {
             compute_generation(state);
             generation_count++;
         }
@@ -1138,23 +684,14 @@ void play_mode(GameState *state) {
             draw_all_visible_chunks(state);
             state->viewport_changed = false;
             state->need_full_refresh = false;
-            state->dirty_count = 0;
+            life_clear_dirty(state->world);
         } else {
-            for (int i = 0; i < state->dirty_count; i++) {
-                int chunk_x = state->dirty_chunks[i].first;
-                int chunk_y = state->dirty_chunks[i].second;
-                Chunk *chunk = get_chunk_if_exists(state, 
-                    chunk_x * CHUNK_SIZE, chunk_y * CHUNK_SIZE);
-                if (chunk) {
-                    draw_chunk(state, chunk_x, chunk_y, chunk);
-                }
-            }
-            state->dirty_count = 0;
+            draw_dirty_chunks(state);
         }
         
         // 显示游戏状态信息
-        mvprintw(0, 0, "PLAY MODE - Gen: %d, Cells: %d | Speed: %d/%d [%c%c]", 
-                 generation_count, state->live_cell_count,
+        mvprintw(0, 0, "PLAY MODE - Gen: %d, Cells: %lld | Speed: %d/%d [%c%c]", 
+                 generation_count, (long long)life_population(state->world),
                  state->speed_level, MAX_SPEED_LEVEL,
                  state->speed_level > MIN_SPEED_LEVEL ? '-' : ' ',
                  state->speed_level < MAX_SPEED_LEVEL ? '+' : ' ');
@@ -1187,8 +724,91 @@ void play_mode(GameState *state) {
     nodelay(stdscr, FALSE);
 }
 
+// 无界面基准测试：测量块查找和演算速度
+int run_benchmark(int argc, char** argv) {
+    GameState state;
+    memset(&state, 0, sizeof(GameState));
+    state.rows = 24;
+    state.cols = 80;
+    state.world = life_create();
+    
+    int generations = 100;
+    const char *filename = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (parse_core_option(&state, argc, argv, &i)) continue;
+        if (strcmp(argv[i], "--bench") == 0) {
+            if (i + 1 < argc && argv[i+1][0] >= '0' && argv[i+1][0] <= '9') {
+                generations = atoi(argv[++i]);
+                if (generations < 1) generations = 1;
+            }
+            if (i + 1 < argc && argv[i+1][0] != '-') filename = argv[++i];
+        }
+    }
+    
+    // 随机汤使用固定种子，保证多次运行可比
+    const int soup_size = 512;
+    if (filename) {
+        if (load_world(&state, filename) != SUCCESS) {
+            fprintf(stderr, "Error loading from %s\n", filename);
+            free_game(&state);
+            return 1;
+        }
+    } else {
+        uint64_t seed = 12345;
+        for (int y = 0; y < soup_size; y++) {
+            for (int x = 0; x < soup_size; x++) {
+                seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                if ((seed >> 33) % 3 == 0) set_cell(&state, x, y, true);
+            }
+        }
+    }
+    LifeStats stats;
+    life_stats(state.world, &stats);
+    printf("Plane %dx%d %s | Chunks: %zu | Cells: %lld\n", life_chunk_size(state.world), life_chunk_size(state.world),
+           life_rule(state.world), stats.chunks, (long long)stats.population);
+    
+    // 块查找：在图案周围逐格调用 peek_cell（扫描范围与 LifeGame.cpp 相同）
+    const int scan_min = -64;
+    const int scan_max = soup_size + 64;
+    const int lookup_rounds = 40;
+    long long hits = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < lookup_rounds; r++) {
+        for (int y = scan_min; y < scan_max; y++) {
+            for (int x = scan_min; x < scan_max; x++) {
+                hits += peek_cell(&state, x, y);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    double lookups = (double)lookup_rounds * (scan_max - scan_min) * (scan_max - scan_min);
+    printf("Lookup: %.1f M/s (%lld hits)\n", lookups / seconds / 1e6, hits);
+    
+    // 演算
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < generations; i++) {
+        compute_generation(&state);
+        life_clear_dirty(state.world);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("Generations: %d in %.3fs | %.2f gen/s | Cells: %lld\n",
+           generations, seconds, generations / seconds, (long long)life_population(state.world));
+    
+    free_game(&state);
+    return 0;
+}
+
 // 主函数
 int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            return run_benchmark(argc, argv);
+        }
+    }
+    
     initscr();
     cbreak();
     noecho();
@@ -1,17 +1,27 @@
-// g++ -o LifeGame LifeGame.cpp -lncurses -pthread  // 通用编译
-// g++ -m32 -O3 -DARM_OPTIMIZED -o LifeGame32 LifeGame.cpp -lncurses -pthread  // 32位优化
-// g++ -O3 -DX64_OPTIMIZED -o LifeGame64 LifeGame.cpp -lncurses -pthread    // 64位优化
+// 先按 LifeCore/lifecore.h 中的说明编译 liblifecore.a（优化选项在编译核心时指定），再编译界面：
+// g++ -O3 -o LifeGame LifeGame.cpp -L. -llifecore -lncurses -pthread
+// ./LifeGame -t 200x100   // 环面世界（上下左右相连）
+// ./LifeGame -b 200x100   // 有界平面（边界外恒为死细胞）
+// ./LifeGame -j 4         // 演算和读写文件的线程数（默认为CPU核数）
+// ./LifeGame -k 128       // 无界平面的块宽度：32/64/128/256（默认32，X64_OPTIMIZED 时为64）
+// ./LifeGame -r B2/S34H   // 演算规则（默认 B3/S23），也可用 Larger-than-Life 形式：-r R5,C0,M1,S34..58,B34..45,NM
+// ./LifeGame [-t WxH | -b WxH | -k 宽度] [-r 规则] --bench [代数] [文件]  // 无界面基准测试（块查找与演算速度）
+// ./LifeGame --serve 7000 [--bench 代数 文件]   // 把每代变化的块推送给远程观看的客户端（[主机:]端口，主机默认 127.0.0.1）
+// ./LifeGame --watch 主机:7000                 // 远程观看：只接收当前视口内的块，wasd 移动视口
+// ./LifeGame --record session.txt [其他参数]   // 录制会话（启动参数、随机种子、初始世界和每次按键）
+// ./LifeGame --replay session.txt              // 无界面全速回放录制的会话，输出演算/绘制/命令/快进各阶段耗时
 
 #include <ncurses.h>
 #include <vector>
 #include <string>
 #include <cstdlib>
 #include <ctime>
-#include <unordered_map>
-#include <unordered_set>
-#include <queue>
+#include <deque>
 #include <algorithm>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <chrono>
 #include <cstring>
 #include <utility>
@@ -20,84 +30,591 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <random>
+#include <cctype>
+#include <memory>
+#include <cerrno>
+#include <unordered_map>
+#include <unordered_set>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "LifeCore/lifecore.h"
 using namespace std;
 
-// 架构特定配置
-#ifdef ARM_OPTIMIZED
-    // 32位ARM优化配置
-    const int CHUNK_SIZE = 32;
-    using BitmapType = uint32_t;
-    const int BITS_PER_UNIT = 32;
-    const int BITMAP_SIZE = (CHUNK_SIZE * CHUNK_SIZE + BITS_PER_UNIT - 1) / BITS_PER_UNIT;
-#elif defined(X64_OPTIMIZED)
-    // 64位x86优化配置
-    const int CHUNK_SIZE = 64;
-    using BitmapType = uint64_t;
-    const int BITS_PER_UNIT = 64;
-    const int BITMAP_SIZE = (CHUNK_SIZE * CHUNK_SIZE + BITS_PER_UNIT - 1) / BITS_PER_UNIT;
-#else
-    // 通用配置
-    const int CHUNK_SIZE = 32;
-    using BitmapType = uint32_t;
-    const int BITS_PER_UNIT = 32;
-    const int BITMAP_SIZE = (CHUNK_SIZE * CHUNK_SIZE + BITS_PER_UNIT - 1) / BITS_PER_UNIT;
-#endif
-
-// 优化邻居计算
-const int neighbor_offsets[8][2] = {
-    {-1, -1}, {0, -1}, {1, -1},
-    {-1,  0},           {1,  0},
-    {-1,  1}, {0,  1}, {1,  1}
+// 历史记录中的一个块：增量帧中为与上一代的异或差分，关键帧中为完整位图
+// 固定尺寸世界以行为单位记录，键为 {0, y}
+struct ChunkRecord {
+    LifeKey key;
+    vector<uint64_t> bits;
+};
+
+// 快速伪随机数（wyrand），每次产生64个随机位
+struct FastRandom {
+    uint64_t state = 0;
+    
+    explicit FastRandom(uint64_t seed = 0) : state(seed) {}
+    
+    inline uint64_t next() {
+        state += 0xA0761D6478BD642FULL;
+        __uint128_t product = static_cast<__uint128_t>(state) * (state ^ 0xE7037ED1A0B428DBULL);
+        return static_cast<uint64_t>(product >> 64) ^ static_cast<uint64_t>(product);
+    }
+    
+    // 每位为1的概率为 density/256：按 density 的二进制位从低到高与/或随机字
+    inline uint64_t next_bits(int density) {
+        if (density <= 0) return 0;
+        if (density >= 256) return ~0ULL;
+        uint64_t bits = 0;
+        for (int i = __builtin_ctz(density); i < 8; i++) {
+            bits = ((density >> i) & 1) ? (bits | next()) : (bits & next());
+        }
+        return bits;
+    }
+};
+
+// 剪贴板/图案：按行存储的位图，原点为左上角
+struct Pattern {
+    int64_t width = 0;
+    int64_t height = 0;
+    size_t words = 0;
+    vector<uint64_t> bits;
+    
+    void init(int64_t w, int64_t h) {
+        width = w;
+        height = h;
+        words = static_cast<size_t>((w + 63) / 64);
+        bits.assign(words * static_cast<size_t>(h), 0);
+    }
+    
+    inline uint64_t word(int64_t k, int64_t y) const {
+        if (k < 0 || k >= static_cast<int64_t>(words)) return 0;
+        return bits[static_cast<size_t>(y) * words + k];
+    }
+    
+    // 取第 y 行从 x 开始的64位，x 可以为负或越界（越界部分为0）
+    inline uint64_t extract(int64_t x, int64_t y) const {
+        if (y < 0 || y >= height) return 0;
+        int64_t k = x >> 6;
+        int shift = static_cast<int>(x & 63);
+        uint64_t value = word(k, y) >> shift;
+        if (shift) value |= word(k + 1, y) << (64 - shift);
+        return value;
+    }
+    
+    // 把 value 的各位或入第 y 行从 x 开始的位置（调用方保证落在图案内的位才非零）
+    inline void insert(int64_t x, int64_t y, uint64_t value) {
+        int64_t k = x >> 6;
+        int shift = static_cast<int>(x & 63);
+        uint64_t* row = &bits[static_cast<size_t>(y) * words];
+        if (k >= 0 && k < static_cast<int64_t>(words)) row[k] |= value << shift;
+        if (shift && k + 1 >= 0 && k + 1 < static_cast<int64_t>(words)) row[k + 1] |= value >> (64 - shift);
+    }
 };
 
-struct Chunk {
-    BitmapType bitmap[BITMAP_SIZE] = {0}; // 位图存储
-    bool dirty = true;
-    int live_count = 0; // 当前块的活细胞计数
-
-    // 获取位值（架构优化版本）
-    inline bool get_bit(int x, int y) const {
-        // 使用int64_t防止溢出
-        int64_t pos = static_cast<int64_t>(y) * CHUNK_SIZE + x;
-        if (pos < 0 || pos >= CHUNK_SIZE * CHUNK_SIZE) return false;
-        size_t idx = static_cast<size_t>(pos) / BITS_PER_UNIT;
-        return (bitmap[idx] >> (pos % BITS_PER_UNIT)) & 1;
-    }
-    
-    // 设置位值（架构优化版本）
-    inline void set_bit(int x, int y, bool value) {
-        // 使用int64_t防止溢出
-        int64_t pos = static_cast<int64_t>(y) * CHUNK_SIZE + x;
-        if (pos < 0 || pos >= CHUNK_SIZE * CHUNK_SIZE) return;
-        size_t idx = static_cast<size_t>(pos) / BITS_PER_UNIT;
-        BitmapType mask = static_cast<BitmapType>(1) << (pos % BITS_PER_UNIT);
-        
-        bool current = (bitmap[idx] & mask) != 0;
-        if (current == value) return;
-        
-        if (value) {
-            bitmap[idx] |= mask;
-            live_count++;
+struct HistoryFrame {
+    int64_t generation = 0;
+    int64_t live_cell_count = 0;
+    vector<ChunkRecord> delta;     // 从上一帧到本帧的异或差分（异或可逆，前进后退共用）
+    bool is_keyframe = false;
+    vector<ChunkRecord> snapshot;  // 关键帧的完整快照
+    size_t bytes = 0;
+};
+
+// 演算历史：frames[0] 总是关键帧，相邻帧之间的代数连续
+struct History {
+    deque<HistoryFrame> frames;
+    size_t position = 0;            // 当前世界对应的帧
+    size_t bytes = 0;
+    size_t max_bytes = 64 << 20;    // 内存上限，0 表示关闭历史
+    int keyframe_interval = 64;
+    bool suspended = false;         // 单个关键帧已超过上限，暂停记录直到世界被编辑
+};
+
+// 以块坐标为键的哈希表（流服务器的镜像与各客户端已有的块）
+struct KeyHash {
+    size_t operator()(const LifeKey& key) const {
+        return hash<uint64_t>()(static_cast<uint64_t>(key.x) * 0x9E3779B97F4A7C15ULL ^ static_cast<uint64_t>(key.y));
+    }
+};
+struct KeyEqual {
+    bool operator()(const LifeKey& a, const LifeKey& b) const { return a.x == b.x && a.y == b.y; }
+};
+template <typename T>
+using KeyMap = unordered_map<LifeKey, T, KeyHash, KeyEqual>;
+using KeySet = unordered_set<LifeKey, KeyHash, KeyEqual>;
+
+// 流协议的整数一律为小端
+void put_le(string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) out.push_back(static_cast<char>(value >> (8 * i)));
+}
+
+uint64_t get_le(const char* data, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) value |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    return value;
+}
+
+// 流连接的套接字缓冲区不宜过大：内核中积压的旧帧无法再合并，慢客户端看到的画面会越来越滞后
+const int STREAM_BUFFER = 64 << 10;
+
+// 打开流服务器的监听套接字，或连接到流服务器；address 为 [主机:]端口，主机默认为 127.0.0.1
+int open_stream_socket(const string& address, bool listening) {
+    string host = "127.0.0.1", port = address;
+    size_t colon = address.rfind(':');
+    if (colon != string::npos) {
+        host = address.substr(0, colon);
+        port = address.substr(colon + 1);
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    addrinfo* result;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) return -1;
+    
+    int fd = -1;
+    for (addrinfo* ai = result; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        int one = 1, buffer_size = STREAM_BUFFER;
+        bool ok;
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            ok = bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 16) == 0;
         } else {
-            bitmap[idx] &= ~mask;
-            live_count--;
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+            ok = connect(fd, ai->ai_addr, ai->ai_addrlen) == 0;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        if (!ok) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(result);
+    if (fd >= 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// 流服务器（--serve）：把每代变化的块推送给远程观看的客户端（--watch），每个客户端只收到与它订阅的视口相交的块
+// 协议（小端）：
+//   服务器 -> 客户端
+//     'H' u8 拓扑 u32 块宽度 i64 宽 i64 高    连接后发送一次
+//     'C' i64 键x i64 键y u32 字数 u32 段数 {u32 零字数 u32 非零字数 u64...}
+//                                             块（固定尺寸世界为行）与客户端已有内容的异或差分，零字按段跳过
+//     'G' i64 代数 i64 活细胞数               一帧结束，客户端据此刷新
+//   客户端 -> 服务器
+//     'V' i64 x0 i64 y0 i64 x1 i64 y1         订阅视口 [x0, x1) x [y0, y1)（可重复发送以移动视口）
+// 演算线程只把差分异或进镜像并记下各客户端需要更新的块；服务线程在客户端的上一帧全部写入套接字后才编码下一帧，
+// 编码时直接比较镜像与客户端已有的内容，慢客户端错过的若干代因此自然合并为一帧，演算线程从不等待网络
+// 镜像只保存各客户端视口内的块，没有客户端时为空；订阅变化或世界被编辑后镜像失效，下次发布时改为从完整快照重建
+struct StreamServer {
+    struct Client {
+        int fd = -1;
+        string in;
+        string out;
+        size_t written = 0;              // out 中已写入套接字的字节数
+        bool closed = false;
+        bool subscribed = false;
+        int64_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+        KeyMap<vector<uint64_t>> known;  // 客户端当前拥有的块（只含视口内的）
+        KeySet pending;                  // 可能与镜像不一致的块
+        bool frame_pending = false;
+        bool drained = true;             // 上一帧已全部写入套接字，正在等待新的一代
+    };
+    
+    LifeTopology topology = LIFE_PLANE;
+    int chunk_size = 0;
+    int64_t width = 0, height = 0;
+    int listen_fd = -1;
+    int wake_fds[2] = {-1, -1};
+    atomic<bool> stopping{false};
+    atomic<bool> wake_sent{false};
+    thread worker;
+    
+    // 以下成员由 lock 保护（clients 的增删只在服务线程中进行）
+    mutex lock;
+    KeyMap<vector<uint64_t>> mirror;  // 世界中被观看的部分
+    bool valid = false;
+    int64_t generation = 0, population = 0;
+    vector<unique_ptr<Client>> clients;
+    
+    StreamServer() = default;
+    StreamServer(const StreamServer&) = delete;
+    StreamServer& operator=(const StreamServer&) = delete;
+    
+    ~StreamServer() {
+        if (worker.joinable()) {
+            stopping = true;
+            wake();
+            worker.join();
+        }
+        for (auto& client : clients) close(client->fd);
+        if (listen_fd >= 0) close(listen_fd);
+        if (wake_fds[0] >= 0) close(wake_fds[0]);
+        if (wake_fds[1] >= 0) close(wake_fds[1]);
+    }
+    
+    bool start(const string& address, const LifeWorld* world) {
+        topology = life_topology(world);
+        chunk_size = life_chunk_size(world);
+        width = life_width(world);
+        height = life_height(world);
+        listen_fd = open_stream_socket(address, true);
+        if (listen_fd < 0 || pipe(wake_fds) != 0) return false;
+        fcntl(wake_fds[0], F_SETFL, O_NONBLOCK);
+        fcntl(wake_fds[1], F_SETFL, O_NONBLOCK);
+        worker = thread([this] { run(); });
+        return true;
+    }
+    
+    void wake() {
+        if (!wake_sent.exchange(true)) {
+            char byte = 0;
+            (void)!write(wake_fds[1], &byte, 1);
+        }
+    }
+    
+    // 块是否与客户端的视口相交；固定尺寸世界按整行发送，环面中视口可以落在任意周期
+    // 视口来自网络，可以是任意的 64 位坐标，差值用 __int128 或无符号数计算，不会溢出
+    bool visible(const Client& client, const LifeKey& key) const {
+        if (!client.subscribed) return false;
+        if (topology == LIFE_PLANE) {
+            __int128 x = static_cast<__int128>(key.x) * chunk_size, y = static_cast<__int128>(key.y) * chunk_size;
+            return x < client.x1 && client.x0 - x < chunk_size && y < client.y1 && client.y0 - y < chunk_size;
+        }
+        if (topology == LIFE_TORUS) {
+            uint64_t rows = static_cast<uint64_t>(client.y1) - static_cast<uint64_t>(client.y0);  // y0 < y1
+            if (rows >= static_cast<uint64_t>(height)) return true;
+            __int128 dy = (static_cast<__int128>(key.y) - client.y0) % height;
+            return static_cast<uint64_t>(dy < 0 ? dy + height : dy) < rows;
+        }
+        return key.y >= client.y0 && key.y < client.y1;
+    }
+    
+    bool watched(const LifeKey& key) const {
+        for (auto& client : clients) {
+            if (visible(*client, key)) return true;
+        }
+        return false;
+    }
+    
+    // 镜像整体替换后，客户端已有的块和视口内的所有块都要重新比较（调用方持有锁）
+    void mark_all(Client& client) {
+        for (auto& entry : client.known) client.pending.insert(entry.first);
+        for (auto& entry : mirror) {
+            if (visible(client, entry.first)) client.pending.insert(entry.first);
+        }
+        client.frame_pending = true;
+    }
+    
+    // 有客户端但镜像已失效：调用方应改为 resync
+    bool wants_snapshot() {
+        lock_guard<mutex> guard(lock);
+        return !valid && !clients.empty();
+    }
+    
+    bool watching() {
+        lock_guard<mutex> guard(lock);
+        return !clients.empty();
+    }
+    
+    // 世界被编辑（不是演算）后调用
+    void invalidate() {
+        lock_guard<mutex> guard(lock);
+        valid = false;
+        mirror.clear();
+    }
+    
+    // 演算线程：把一代的异或差分计入镜像
+    void publish(const vector<ChunkRecord>& records, int64_t new_generation, int64_t new_population) {
+        lock_guard<mutex> guard(lock);
+        if (!valid) return;
+        if (records.empty() && new_generation == generation && new_population == population) return;
+        for (const ChunkRecord& record : records) {
+            if (!watched(record.key)) continue;
+            vector<uint64_t>& bits = mirror[record.key];
+            if (bits.empty()) bits.assign(record.bits.size(), 0);
+            bool empty = true;
+            for (size_t i = 0; i < bits.size(); i++) {
+                bits[i] ^= record.bits[i];
+                empty &= bits[i] == 0;
+            }
+            if (empty) mirror.erase(record.key);
+            for (auto& client : clients) {
+                if (visible(*client, record.key)) client->pending.insert(record.key);
+            }
+        }
+        generation = new_generation;
+        population = new_population;
+        // 只在有客户端等着下一帧时唤醒服务线程，慢客户端由套接字可写时的 poll 唤醒
+        bool idle = false;
+        for (auto& client : clients) {
+            if (!client->subscribed) continue;
+            idle |= client->drained && !client->frame_pending;
+            client->frame_pending = true;
+        }
+        if (idle) wake();
+    }
+    
+    // 演算线程：用完整快照替换镜像
+    void resync(const vector<ChunkRecord>& snapshot, int64_t new_generation, int64_t new_population) {
+        lock_guard<mutex> guard(lock);
+        mirror.clear();
+        for (const ChunkRecord& record : snapshot) {
+            if (watched(record.key)) mirror[record.key] = record.bits;
+        }
+        valid = true;
+        generation = new_generation;
+        population = new_population;
+        for (auto& client : clients) {
+            if (client->subscribed) mark_all(*client);
+        }
+        wake();
+    }
+    
+    static void append_chunk(string& out, const LifeKey& key, const vector<uint64_t>& diff) {
+        out.push_back('C');
+        put_le(out, static_cast<uint64_t>(key.x), 8);
+        put_le(out, static_cast<uint64_t>(key.y), 8);
+        put_le(out, diff.size(), 4);
+        size_t runs_at = out.size();
+        put_le(out, 0, 4);
+        uint32_t runs = 0;
+        for (size_t i = 0; i < diff.size(); runs++) {
+            size_t start = i;
+            while (i < diff.size() && !diff[i]) i++;
+            if (i == diff.size()) break;
+            size_t literal = i;
+            while (i < diff.size() && diff[i]) i++;
+            put_le(out, literal - start, 4);
+            put_le(out, i - literal, 4);
+            for (size_t k = literal; k < i; k++) put_le(out, diff[k], 8);
+        }
+        for (int b = 0; b < 4; b++) out[runs_at + b] = static_cast<char>(runs >> (8 * b));
+    }
+    
+    // 把镜像与客户端已有内容的差别编码为一帧（调用方持有锁）
+    void encode_frame(Client& client) {
+        vector<uint64_t> diff;
+        for (const LifeKey& key : client.pending) {
+            auto now = visible(client, key) ? mirror.find(key) : mirror.end();
+            auto old = client.known.find(key);
+            const vector<uint64_t>* current = now != mirror.end() ? &now->second : nullptr;
+            const vector<uint64_t>* previous = old != client.known.end() ? &old->second : nullptr;
+            if (!current && !previous) continue;
+            
+            diff.assign(current ? current->size() : previous->size(), 0);
+            bool changed = false;
+            for (size_t i = 0; i < diff.size(); i++) {
+                diff[i] = (current ? (*current)[i] : 0) ^ (previous ? (*previous)[i] : 0);
+                changed |= diff[i] != 0;
+            }
+            if (!changed) continue;
+            append_chunk(client.out, key, diff);
+            if (current) {
+                client.known[key] = *current;
+            } else {
+                client.known.erase(old);
+            }
+        }
+        client.pending.clear();
+        client.out.push_back('G');
+        put_le(client.out, static_cast<uint64_t>(generation), 8);
+        put_le(client.out, static_cast<uint64_t>(population), 8);
+        client.frame_pending = false;
+    }
+    
+    void accept_clients() {
+        while (true) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) return;
+            int one = 1, buffer_size = STREAM_BUFFER;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            auto client = make_unique<Client>();
+            client->fd = fd;
+            client->out.push_back('H');
+            put_le(client->out, static_cast<uint64_t>(topology), 1);
+            put_le(client->out, static_cast<uint64_t>(chunk_size), 4);
+            put_le(client->out, static_cast<uint64_t>(width), 8);
+            put_le(client->out, static_cast<uint64_t>(height), 8);
+            lock_guard<mutex> guard(lock);
+            clients.push_back(move(client));
+        }
+    }
+    
+    // 读取并处理客户端的订阅消息
+    void read_client(Client& client) {
+        char buffer[4096];
+        while (true) {
+            ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                client.in.append(buffer, static_cast<size_t>(n));
+                continue;
+            }
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) client.closed = true;
+            break;
+        }
+        
+        // 一次读入的多条订阅只用最后一条，视口没变时不重建镜像（每次重建都要从完整快照开始）
+        const size_t message_size = 1 + 4 * 8;
+        size_t pos = 0;
+        bool changed = false;
+        int64_t x0 = client.x0, y0 = client.y0, x1 = client.x1, y1 = client.y1;
+        for (; !client.closed && client.in.size() - pos >= message_size; pos += message_size) {
+            const char* data = client.in.data() + pos;
+            x0 = static_cast<int64_t>(get_le(data + 1, 8));
+            y0 = static_cast<int64_t>(get_le(data + 9, 8));
+            x1 = static_cast<int64_t>(get_le(data + 17, 8));
+            y1 = static_cast<int64_t>(get_le(data + 25, 8));
+            if (data[0] != 'V' || x0 >= x1 || y0 >= y1) {
+                client.closed = true;
+                break;
+            }
+            changed = true;
+        }
+        client.in.erase(0, pos);
+        if (client.closed || !changed) return;
+        if (client.subscribed && x0 == client.x0 && y0 == client.y0 && x1 == client.x1 && y1 == client.y1) return;
+        
+        // 新的视口中可能有镜像里没有的块，由演算线程重建镜像
+        lock_guard<mutex> guard(lock);
+        client.x0 = x0;
+        client.y0 = y0;
+        client.x1 = x1;
+        client.y1 = y1;
+        client.subscribed = true;
+        valid = false;
+        mirror.clear();
+    }
+    
+    void write_client(Client& client) {
+        while (client.written < client.out.size()) {
+            ssize_t n = send(client.fd, client.out.data() + client.written, client.out.size() - client.written,
+                             MSG_NOSIGNAL);
+            if (n > 0) {
+                client.written += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) client.closed = true;
+            return;
+        }
+        client.out.clear();
+        client.written = 0;
+    }
+    
+    // 服务线程：等待连接、订阅和新的一代；客户端的上一帧写完后才编码下一帧
+    void run() {
+        vector<pollfd> fds;
+        while (!stopping) {
+            fds.clear();
+            fds.push_back({wake_fds[0], POLLIN, 0});
+            fds.push_back({listen_fd, POLLIN, 0});
+            bool ready = false;  // 有客户端可以立即编码下一帧
+            {
+                lock_guard<mutex> guard(lock);
+                for (auto& client : clients) {
+                    short events = POLLIN;
+                    if (client->written < client->out.size()) events |= POLLOUT;
+                    fds.push_back({client->fd, events, 0});
+                    ready |= client->drained && client->frame_pending && valid;
+                }
+            }
+            if (poll(fds.data(), fds.size(), ready ? 0 : -1) < 0 && errno != EINTR) break;
+            
+            if (fds[0].revents) {
+                char buffer[64];
+                while (read(wake_fds[0], buffer, sizeof(buffer)) > 0) {}
+                wake_sent = false;
+            }
+            for (size_t i = 0; i + 2 < fds.size(); i++) {
+                if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) read_client(*clients[i]);
+            }
+            if (fds[1].revents & POLLIN) accept_clients();
+            
+            for (auto& client : clients) {
+                if (client->closed) continue;
+                if (client->written == client->out.size()) {
+                    lock_guard<mutex> guard(lock);
+                    if (client->frame_pending && valid) encode_frame(*client);
+                }
+                write_client(*client);
+                lock_guard<mutex> guard(lock);
+                client->drained = client->written == client->out.size();
+            }
+            
+            // 移除断开的客户端；最后一个客户端离开后释放镜像
+            lock_guard<mutex> guard(lock);
+            for (size_t i = 0; i < clients.size();) {
+                if (clients[i]->closed) {
+                    close(clients[i]->fd);
+                    clients.erase(clients.begin() + i);
+                } else {
+                    i++;
+                }
+            }
+            if (clients.empty() && valid) {
+                mirror.clear();
+                valid = false;
+            }
         }
-        dirty = true;
     }
 };
 
 enum Mode { DESIGN, COMMAND, PLAY };
 
+enum CommandResult { SUCCESS, ERROR, CANCEL };
+
+// 会话录制（--record）与回放（--replay）
+// 文件为文本：头部是启动参数、随机数种子、终端尺寸和初始世界的活细胞，之后每行一个事件：
+//   k <模式 D/C/P> <代数> <键码>   按键（只记录真正按下的键）
+//   f <代数>                       快进实际完成的代数（按时间预算或被取消的快进因此也能重现）
+// 回放时无界面全速运行：演算模式中的按键等到记录时的那一代才给出，不再等待帧间隔和提示信息
+struct SessionEvent {
+    char type;
+    char mode;
+    int64_t generation;
+    int64_t value;
+};
+
+struct Session {
+    FILE* record = nullptr;
+    bool replay = false;
+    uint64_t seed = 0;
+    int rows = 0, cols = 0;
+    vector<string> args;
+    vector<pair<int64_t, int64_t>> cells;
+    vector<SessionEvent> events;
+    size_t next = 0;
+    int64_t waiting_generation = -1;  // 回放中上次等待按键时的代数
+    bool diverged = false;            // 回放与录制不一致（例如读入的文件已改变）
+};
+
+// 回放时按阶段统计耗时；嵌套的阶段（命令中的快进）不计入外层
+enum Phase { PHASE_COMPUTE, PHASE_DRAW, PHASE_COMMAND, PHASE_FAST_FORWARD, PHASE_COUNT };
+
+struct PhaseStats {
+    double seconds[PHASE_COUNT] = {0};
+    int64_t count[PHASE_COUNT] = {0};
+    double accounted = 0;  // 已结束的最外层计时之和（嵌套计时由外层扣除）
+};
+
 struct GameState {
     Mode mode = DESIGN;
     int rows, cols;
     
-    // 使用块存储的世界
-    unordered_map<int, unordered_map<int, Chunk*>> world;
+    // 模拟核心：世界存储、演算、文件读写（见 LifeCore/lifecore.h）
+    LifeWorld* world = life_create();
     
-    int live_cell_count = 0;
-    int viewport_x = 0;
-    int viewport_y = 0;
+    int64_t viewport_x = 0;
+    int64_t viewport_y = 0;
     int cursor_screen_x = 0;
     int cursor_screen_y = 0;
     int prev_cursor_screen_x = -1;
@@ -107,107 +624,265 @@ struct GameState {
     
     string command_str;
     bool precompute = false;
-    int precompute_rounds = 20;
+    int64_t precompute_rounds = 20;
     bool running = true;
     
-    vector<pair<int, int>> dirty_chunks;
+    // 区域操作使用的随机数和剪贴板
+    FastRandom rng;
+    Pattern clipboard;
+    
+    int64_t generation = 0;
+    History history;
+    
+    // find 命令的结果，只在查找时的那一代（且世界未被编辑）显示
+    vector<LifeMatch> matches;
+    size_t match_index = 0;
+    int64_t match_generation = -1;
     
-    // 重用数据结构减少内存分配
-    vector<pair<int, int>> positions_to_check;
-    vector<tuple<int, int, bool>> updates;
+    // --serve 开启的流服务器
+    unique_ptr<StreamServer> server;
     
-    // 析构函数释放内存
+    Session session;
+    PhaseStats phases;
+    
+    GameState() = default;
+    GameState(const GameState&) = delete;
+    GameState& operator=(const GameState&) = delete;
     ~GameState() {
-        for (auto& [y, row] : world) {
-            for (auto& [x, chunk] : row) {
-                delete chunk;
-            }
-        }
+        life_destroy(world);
+        if (session.record) fclose(session.record);
     }
 };
 
-Chunk* get_chunk_if_exists(GameState& state, int world_x, int world_y) {
-    // 防止极端坐标值
-    if (world_x < INT_MIN/2 || world_x > INT_MAX/2 || 
-        world_y < INT_MIN/2 || world_y > INT_MAX/2) {
-        return nullptr;
-    }
+struct PhaseTimer {
+    GameState& state;
+    Phase phase;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    double accounted_before;
     
-    int chunk_x = world_x / CHUNK_SIZE;
-    int chunk_y = world_y / CHUNK_SIZE;
+    bool running = true;
     
-    auto row_it = state.world.find(chunk_y);
-    if (row_it == state.world.end()) return nullptr;
+    PhaseTimer(GameState& s, Phase p) : state(s), phase(p), accounted_before(s.phases.accounted) {}
+    ~PhaseTimer() { stop(); }
     
-    auto chunk_it = row_it->second.find(chunk_x);
-    return (chunk_it != row_it->second.end()) ? chunk_it->second : nullptr;
+    void stop() {
+        if (!running) return;
+        running = false;
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        PhaseStats& phases = state.phases;
+        phases.seconds[phase] += elapsed - (phases.accounted - accounted_before);
+        phases.count[phase]++;
+        phases.accounted = accounted_before + elapsed;
+    }
+};
+
+char mode_letter(Mode mode) {
+    return mode == DESIGN ? 'D' : mode == COMMAND ? 'C' : 'P';
 }
 
-Chunk* get_chunk(GameState& state, int world_x, int world_y) {
-    // 防止极端坐标值
-    if (world_x < INT_MIN/2 || world_x > INT_MAX/2 || 
-        world_y < INT_MIN/2 || world_y > INT_MAX/2) {
-        return nullptr;
+// 读取一个按键（代替 getch）：录制时记下按下的键；回放时按记录给出，记录用完或与录制不一致时给出退出键
+int read_key(GameState &state) {
+    Session& session = state.session;
+    if (!session.replay) {
+        int ch = getch();
+        if (ch != ERR && session.record) {
+            fprintf(session.record, "k %c %lld %d\n", mode_letter(state.mode), (long long)state.generation, ch);
+            fflush(session.record);
+        }
+        return ch;
     }
     
-    int chunk_x = world_x / CHUNK_SIZE;
-    int chunk_y = world_y / CHUNK_SIZE;
-    
-    auto& row = state.world[chunk_y];
-    auto it = row.find(chunk_x);
-    if (it != row.end()) return it->second;
-    
-    Chunk* chunk = new Chunk();
-    row[chunk_x] = chunk;
-    return chunk;
+    auto quit_key = [&] { return state.mode == COMMAND ? 27 : 'q'; };
+    if (session.diverged || session.next >= session.events.size()) return quit_key();
+    const SessionEvent& event = session.events[session.next];
+    if (event.type == 'k' && event.mode == mode_letter(state.mode) && state.mode == PLAY &&
+        event.generation > state.generation) {
+        // 演算模式中还没到按下的那一代，继续演算；世界停止变化（暂停或已空）却还没到说明已不一致
+        if (state.generation != session.waiting_generation) {
+            session.waiting_generation = state.generation;
+            return ERR;
+        }
+    } else if (event.type == 'k' && event.mode == mode_letter(state.mode) && event.generation == state.generation) {
+        session.next++;
+        session.waiting_generation = -1;
+        return static_cast<int>(event.value);
+    }
+    session.diverged = true;
+    return quit_key();
 }
 
-bool peek_cell(GameState& state, int world_x, int world_y) {
-    // 显式检查坐标是否在有效范围内
-    if (world_x < INT_MIN + CHUNK_SIZE || world_x > INT_MAX - CHUNK_SIZE ||
-        world_y < INT_MIN + CHUNK_SIZE || world_y > INT_MAX - CHUNK_SIZE) {
-        return false;
-    }
-    
-    Chunk* chunk = get_chunk_if_exists(state, world_x, world_y);
-    if (!chunk) return false;
-    
-    int local_x = world_x % CHUNK_SIZE;
-    int local_y = world_y % CHUNK_SIZE;
-    
-    // 处理负数坐标的取模
-    if (local_x < 0) local_x += CHUNK_SIZE;
-    if (local_y < 0) local_y += CHUNK_SIZE;
+// 命令结果在命令行上停留一会儿；回放时不等待
+void hold_message(GameState &state, int seconds) {
+    if (!state.session.replay) this_thread::sleep_for(chrono::seconds(seconds));
+}
+
+void clear_world(GameState& state) {
+    life_clear(state.world);
+}
+
+bool peek_cell(GameState& state, int64_t world_x, int64_t world_y) {
+    return life_get(state.world, world_x, world_y);
+}
+
+void set_cell(GameState& state, int64_t world_x, int64_t world_y, bool alive) {
+    life_set(state.world, world_x, world_y, alive);
+}
+
+// 遍历所有活细胞，fn(world_x, world_y)
+template <typename Fn>
+void for_each_live_cell(GameState& state, Fn&& fn) {
+    life_for_each_live(state.world, [](void* ctx, int64_t x, int64_t y) {
+        (*static_cast<remove_reference_t<Fn>*>(ctx))(x, y);
+    }, &fn);
+}
+
+// 区域 [x0, x1) x [y0, y1) 按存储字批量操作
+// fn(old, mask, base_x, y) 返回新的字，mask 为该字中落在区域内的位，base_x 为该字第0位的世界x坐标
+// create 为 false 时跳过不存在的块（清除、复制不需要分配新块）
+template <typename Fn>
+void for_each_region_word(GameState& state, int64_t x0, int64_t y0, int64_t x1, int64_t y1,
+                          bool create, Fn&& fn) {
+    life_region(state.world, x0, y0, x1, y1, create,
+        [](void* ctx, uint64_t old, uint64_t mask, int64_t base_x, int64_t y) -> uint64_t {
+            return (*static_cast<remove_reference_t<Fn>*>(ctx))(old, mask, base_x, y);
+        }, &fn);
+}
+
+enum RegionOp { REGION_FILL, REGION_CLEAR, REGION_INVERT, REGION_RANDOM };
+
+// 区域命令的面积上限（细胞数）：填充、复制等会为区域分配内存
+const int64_t REGION_LIMIT = 1LL << 32;
+
+// 区域参数是否可用：宽高为正，面积不超过上限，右下角不超出坐标范围（都不做会溢出的乘法和加法）
+bool valid_region(int64_t x, int64_t y, int64_t w, int64_t h) {
+    return w > 0 && h > 0 && w <= REGION_LIMIT / h && x <= INT64_MAX - w && y <= INT64_MAX - h;
+}
+
+// 矩形区域填充/清除/反转/随机填充，返回区域内活细胞数的变化
+// density 为随机填充的概率（0..256 对应 0..100%），随机填充只增加细胞
+int64_t region_op(GameState& state, RegionOp op, int64_t x, int64_t y, int64_t w, int64_t h, int density = 85) {
+    int64_t before = life_population(state.world);
+    bool create = (op != REGION_CLEAR);
     
-    return chunk->get_bit(local_x, local_y);
+    for_each_region_word(state, x, y, x + w, y + h, create,
+        [&](uint64_t old, uint64_t, int64_t, int64_t) -> uint64_t {
+            switch (op) {
+                case REGION_FILL: return ~0ULL;
+                case REGION_CLEAR: return 0;
+                case REGION_INVERT: return ~old;
+                case REGION_RANDOM: return old | state.rng.next_bits(density);
+            }
+            return old;
+        });
+    return life_population(state.world) - before;
 }
 
-void set_cell(GameState& state, int world_x, int world_y, bool alive) {
-    // 防止极端坐标值
-    if (world_x < INT_MIN/2 || world_x > INT_MAX/2 || 
-        world_y < INT_MIN/2 || world_y > INT_MAX/2) {
-        return;
+// 复制区域到剪贴板
+void copy_region(GameState& state, int64_t x, int64_t y, int64_t w, int64_t h) {
+    state.clipboard.init(w, h);
+    for_each_region_word(state, x, y, x + w, y + h, false,
+        [&](uint64_t old, uint64_t mask, int64_t base_x, int64_t row_y) -> uint64_t {
+            state.clipboard.insert(base_x - x, row_y - y, old & mask);
+            return old;
+        });
+}
+
+// 把图案盖印到世界，左上角对齐 (x, y)，只增加细胞
+int64_t paste_pattern(GameState& state, const Pattern& pattern, int64_t x, int64_t y) {
+    int64_t before = life_population(state.world);
+    for_each_region_word(state, x, y, x + pattern.width, y + pattern.height, true,
+        [&](uint64_t old, uint64_t, int64_t base_x, int64_t row_y) -> uint64_t {
+            return old | pattern.extract(base_x - x, row_y - y);
+        });
+    return life_population(state.world) - before;
+}
+
+// 读取 Life 1.06 文件为图案，坐标平移到包围盒左上角
+CommandResult load_pattern(const string& filename, Pattern& pattern) {
+    unique_ptr<LifeWorld, decltype(&life_destroy)> cells(life_create(), life_destroy);
+    if (!life_load(cells.get(), filename.c_str(), nullptr, nullptr)) {
+        return ERROR;
     }
     
-    Chunk* chunk = get_chunk(state, world_x, world_y);
-    int local_x = world_x % CHUNK_SIZE;
-    int local_y = world_y % CHUNK_SIZE;
-    
-    // 处理负数坐标的取模
-    if (local_x < 0) local_x += CHUNK_SIZE;
-    if (local_y < 0) local_y += CHUNK_SIZE;
+    LifeStats stats;
+    life_stats(cells.get(), &stats);
+    if (stats.population == 0) {
+        pattern.init(0, 0);
+        return SUCCESS;
+    }
+    // 图案位图最多 2^32 个细胞
+    int64_t max_x = stats.max_x, max_y = stats.max_y, min_x = stats.min_x, min_y = stats.min_y;
+    if (max_x - min_x >= (1LL << 32) || max_y - min_y >= (1LL << 32) ||
+        (max_x - min_x + 1) * (max_y - min_y + 1) > (1LL << 32)) {
+        return ERROR;
+    }
     
-    bool current = chunk->get_bit(local_x, local_y);
-    if (current != alive) {
-        chunk->set_bit(local_x, local_y, alive);
-        
-        if (alive) state.live_cell_count++;
-        else state.live_cell_count--;
-        
-        int chunk_x = world_x / CHUNK_SIZE;
-        int chunk_y = world_y / CHUNK_SIZE;
-        state.dirty_chunks.push_back({chunk_x, chunk_y});
+    pattern.init(max_x - min_x + 1, max_y - min_y + 1);
+    struct Origin { Pattern* pattern; int64_t x, y; } origin{&pattern, min_x, min_y};
+    life_for_each_live(cells.get(), [](void* ctx, int64_t x, int64_t y) {
+        Origin& origin = *static_cast<Origin*>(ctx);
+        origin.pattern->insert(x - origin.x, y - origin.y, 1);
+    }, &origin);
+    return SUCCESS;
+}
+
+// 在世界中查找图案的所有出现（8个朝向），结果存入 state.matches，返回匹配数，图案过大时返回 -1
+int64_t find_pattern(GameState& state, const Pattern& pattern) {
+    if (pattern.width > LIFE_MAX_FIND || pattern.height > LIFE_MAX_FIND) return -1;
+    auto collect = [](void* ctx, const LifeMatch* match) {
+        static_cast<vector<LifeMatch>*>(ctx)->push_back(*match);
+    };
+    int64_t count = life_find(state.world, pattern.bits.data(), static_cast<int>(pattern.width),
+                              static_cast<int>(pattern.height), collect, &state.matches);
+    state.match_index = 0;
+    state.match_generation = state.generation;
+    return count;
+}
+
+// 把视口中心移到世界坐标 (x, y)
+void center_viewport(GameState& state, int64_t x, int64_t y) {
+    state.viewport_x = x - state.cols / 2;
+    state.viewport_y = y - state.rows / 2;
+    state.viewport_changed = true;
+}
+
+// 解析 -t/-b 的 WxH 参数
+bool set_topology(GameState &state, LifeTopology topology, const char* size) {
+    long long w, h;
+    char tail;
+    if (sscanf(size, "%lldx%lld%c", &w, &h, &tail) != 2) return false;
+    return life_set_topology(state.world, topology, w, h);
+}
+
+// 切换无界平面的块几何（会清空世界），不支持的宽度返回 false
+bool set_chunk_size(GameState &state, int size) {
+    return life_set_chunk_size(state.world, size);
+}
+
+int chunk_size(const GameState &state) {
+    return life_chunk_size(state.world);
+}
+
+// 状态栏中的拓扑与规则说明
+string topology_label(const GameState &state) {
+    LifeTopology topology = life_topology(state.world);
+    string label;
+    if (topology == LIFE_PLANE) {
+        label = "Plane " + to_string(chunk_size(state)) + "x" + to_string(chunk_size(state));
+    } else {
+        label = (topology == LIFE_TORUS ? "Torus " : "Bounded ") +
+                to_string(life_width(state.world)) + "x" + to_string(life_height(state.world));
     }
+    return label + " " + life_rule(state.world);
+}
+
+// 状态栏中的包围盒（左上角与尺寸），统计是增量维护的，每帧查询不扫描细胞
+string box_label(const GameState &state) {
+    LifeStats stats;
+    life_stats(state.world, &stats);
+    if (stats.population == 0) return "Box: -";
+    return "Box: " + to_string(stats.max_x - stats.min_x + 1) + "x" + to_string(stats.max_y - stats.min_y + 1) +
+           " at (" + to_string(stats.min_x) + ", " + to_string(stats.min_y) + ")";
 }
 
 void init_game(GameState &state, int argc, char** argv) {
@@ -216,174 +891,578 @@ void init_game(GameState &state, int argc, char** argv) {
     state.cursor_screen_x = state.cols / 2;
     state.cursor_screen_y = state.rows / 2;
     
+    string serve_address, record_file;
+    vector<string> args;  // 录制时写入文件头的启动参数（不含录制和流服务器参数）
+    for (int i = 1; i < argc; i++) {
+        bool session_option = (strcmp(argv[i], "--record") == 0 || strcmp(argv[i], "--serve") == 0) && i + 1 < argc;
+        if (session_option) {
+            i++;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-z") == 0) {
             state.precompute = true;
             if (i + 1 < argc) {
                 char* end;
                 long rounds = strtol(argv[i+1], &end, 10);
-                if (*end == '\0' && rounds > 0 && rounds <= 1000) {
+                if (*end == '\0' && rounds > 0) {
                     state.precompute_rounds = rounds;
                     i++;
                 }
             }
         }
+        else if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "-b") == 0) && i + 1 < argc) {
+            if (set_topology(state, argv[i][1] == 't' ? LIFE_TORUS : LIFE_BOUNDED, argv[i+1])) {
+                i++;
+            }
+        }
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            if (set_chunk_size(state, atoi(argv[i+1]))) {
+                i++;
+            }
+        }
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            if (life_set_rule(state.world, argv[i+1])) {
+                i++;
+            }
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            char* end;
+            long threads = strtol(argv[i+1], &end, 10);
+            if (*end == '\0' && threads > 0 && threads <= 256) {
+                life_set_threads(state.world, threads);
+                i++;
+            }
+        }
+        else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            // 历史内存上限（MB），0 关闭回退功能
+            char* end;
+            long mb = strtol(argv[i+1], &end, 10);
+            if (*end == '\0' && mb >= 0 && mb <= (1 << 20)) {
+                state.history.max_bytes = static_cast<size_t>(mb) << 20;
+                i++;
+            }
+        }
+        else if (strcmp(argv[i], "-K") == 0 && i + 1 < argc) {
+            // 关键帧间隔（代）
+            char* end;
+            long interval = strtol(argv[i+1], &end, 10);
+            if (*end == '\0' && interval > 0 && interval <= 1000000) {
+                state.history.keyframe_interval = interval;
+                i++;
+            }
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve_address = argv[++i];
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_file = argv[++i];
+        }
     }
     
-    // 预分配内存
-    state.positions_to_check.reserve(2048);
-    state.updates.reserve(1024);
-}
-
-void compute_generation(GameState &state) {
-    if (state.live_cell_count == 0) return;
+    // 流服务器在拓扑和块宽度确定之后启动
+    if (!serve_address.empty()) {
+        state.server = make_unique<StreamServer>();
+        if (!state.server->start(serve_address, state.world)) {
+            endwin();
+            fprintf(stderr, "Cannot listen on %s\n", serve_address.c_str());
+            exit(1);
+        }
+    }
     
-    state.positions_to_check.clear();
-    state.updates.clear();
+    // 回放时使用录制时的种子和初始世界
+    Session& session = state.session;
+    uint64_t seed = session.replay ? session.seed
+                                   : static_cast<uint64_t>(time(nullptr)) ^ (static_cast<uint64_t>(rand()) << 32);
+    state.rng = FastRandom(seed);
+    if (session.replay) {
+        for (auto& cell : session.cells) set_cell(state, cell.first, cell.second, true);
+    }
     
-    // 只处理包含活细胞的块
-    for (auto& [chunk_y, row] : state.world) {
-        for (auto& [chunk_x, chunk] : row) {
-            if (!chunk || chunk->live_count == 0) continue;
-            
-            int world_base_x = chunk_x * CHUNK_SIZE;
-            int world_base_y = chunk_y * CHUNK_SIZE;
-            
-            // 扫描位图寻找活细胞
-            for (int y = 0; y < CHUNK_SIZE; y++) {
-                for (int x = 0; x < CHUNK_SIZE; x++) {
-                    if (!chunk->get_bit(x, y)) continue;
-                    
-                    int world_x = world_base_x + x;
-                    int world_y = world_base_y + y;
-                    
-                    // 添加活细胞及其邻居
-                    for (int i = 0; i < 8; i++) {
-                        int nx = world_x + neighbor_offsets[i][0];
-                        int ny = world_y + neighbor_offsets[i][1];
-                        state.positions_to_check.emplace_back(nx, ny);
-                    }
-                    state.positions_to_check.emplace_back(world_x, world_y);
-                }
-            }
+    if (!record_file.empty()) {
+        session.record = fopen(record_file.c_str(), "w");
+        if (!session.record) {
+            endwin();
+            fprintf(stderr, "Cannot record to %s\n", record_file.c_str());
+            exit(1);
         }
+        // 每个参数一行，原样写在 "arg " 之后，参数中可以有空格
+        fprintf(session.record, "#LifeGame session\n");
+        for (auto& arg : args) fprintf(session.record, "arg %s\n", arg.c_str());
+        fprintf(session.record, "seed %llu\nsize %d %d\n", (unsigned long long)seed, state.rows, state.cols);
+        for_each_live_cell(state, [&](int64_t x, int64_t y) {
+            fprintf(session.record, "cell %lld %lld\n", (long long)x, (long long)y);
+        });
+        fflush(session.record);
     }
+}
+
+// 读取录制的会话文件
+bool load_session(const string& filename, Session& session) {
+    ifstream file(filename);
+    if (!file) return false;
+    string line;
+    bool has_size = false;
+    while (getline(file, line)) {
+        istringstream iss(line);
+        string type;
+        if (!(iss >> type) || type[0] == '#') continue;
+        if (type == "arg") {
+            session.args.push_back(line.size() > 4 ? line.substr(4) : string());
+        } else if (type == "args") {
+            // 旧格式：所有参数以空格分隔写在一行
+            string arg;
+            while (iss >> arg) session.args.push_back(arg);
+        } else if (type == "seed") {
+            unsigned long long seed;
+            if (!(iss >> seed)) return false;
+            session.seed = seed;
+        } else if (type == "size") {
+            if (!(iss >> session.rows >> session.cols) || session.rows <= 0 || session.cols <= 0) return false;
+            has_size = true;
+        } else if (type == "cell") {
+            long long x, y;
+            if (!(iss >> x >> y)) return false;
+            session.cells.push_back({x, y});
+        } else if (type == "k") {
+            SessionEvent event{'k', 0, 0, 0};
+            long long generation, key;
+            if (!(iss >> event.mode >> generation >> key)) return false;
+            event.generation = generation;
+            event.value = key;
+            session.events.push_back(event);
+        } else if (type == "f") {
+            long long generations;
+            if (!(iss >> generations) || generations < 0) return false;
+            session.events.push_back({'f', 0, 0, generations});
+        } else {
+            return false;
+        }
+    }
+    return has_size;
+}
+
+// delta 非空时写入本代与上一代的异或差分（固定尺寸世界按行记录）
+void compute_generation(GameState &state, vector<ChunkRecord>* delta = nullptr) {
+    if (life_population(state.world) == 0) return;
     
-    // 排序去重
-    sort(state.positions_to_check.begin(), state.positions_to_check.end());
-    auto last = unique(state.positions_to_check.begin(), state.positions_to_check.end());
-    state.positions_to_check.erase(last, state.positions_to_check.end());
-    
-    // 计算每个位置的下一代状态
-    for (auto& pos : state.positions_to_check) {
-        int world_x = pos.first;
-        int world_y = pos.second;
-        int neighbors = 0;
+    if (!delta) {
+        life_step(state.world, nullptr, nullptr);
+        return;
+    }
+    life_step(state.world, [](void* ctx, LifeKey key, const uint64_t* bits, size_t words) {
+        static_cast<vector<ChunkRecord>*>(ctx)->push_back({key, vector<uint64_t>(bits, bits + words)});
+    }, delta);
+}
+
+// 把一条记录异或进世界（增量帧的前进和后退都用它）
+void xor_record(GameState &state, const ChunkRecord& record) {
+    life_xor_record(state.world, record.key, record.bits.data(), record.bits.size());
+}
+
+// 完整快照：所有非空块（固定尺寸世界为所有非空行）
+vector<ChunkRecord> take_snapshot(GameState &state) {
+    vector<ChunkRecord> snapshot;
+    life_snapshot(state.world, [](void* ctx, LifeKey key, const uint64_t* bits, size_t words) {
+        static_cast<vector<ChunkRecord>*>(ctx)->push_back({key, vector<uint64_t>(bits, bits + words)});
+    }, &snapshot);
+    return snapshot;
+}
+
+void restore_snapshot(GameState &state, const vector<ChunkRecord>& snapshot) {
+    // 空世界异或快照即为快照本身
+    clear_world(state);
+    for (auto& record : snapshot) {
+        xor_record(state, record);
+    }
+    state.need_full_refresh = true;
+    if (state.server) state.server->invalidate();
+}
+
+size_t records_bytes(const vector<ChunkRecord>& records) {
+    size_t bytes = 0;
+    for (auto& record : records) {
+        bytes += sizeof(ChunkRecord) + record.bits.size() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+// 世界被编辑（而不是演算）后旧历史失效
+void history_reset(GameState &state) {
+    state.history.frames.clear();
+    state.history.position = 0;
+    state.history.bytes = 0;
+    state.history.suspended = false;
+    // 流服务器的镜像也随之失效，下次发布时发送完整快照
+    if (state.server) state.server->invalidate();
+    // 查找结果随之失效，重绘以去掉标记
+    if (!state.matches.empty()) {
+        state.matches.clear();
+        state.need_full_refresh = true;
+    }
+}
+
+bool history_enabled(const GameState &state) {
+    return state.history.max_bytes > 0 && !state.history.suspended;
+}
+
+// 超过内存上限时从最早的关键帧段开始丢弃，保证 frames[0] 仍是关键帧
+void history_trim(GameState &state) {
+    History& history = state.history;
+    while (history.bytes > history.max_bytes) {
+        size_t next_key = 1;
+        while (next_key <= history.position && !history.frames[next_key].is_keyframe) next_key++;
+        if (next_key > history.position) break;
         
-        // 计算邻居
-        for (int i = 0; i < 8; i++) {
-            int nx = world_x + neighbor_offsets[i][0];
-            int ny = world_y + neighbor_offsets[i][1];
-            
-            if (peek_cell(state, nx, ny)) {
-                neighbors++;
-            }
+        for (size_t i = 0; i < next_key; i++) {
+            history.bytes -= history.frames.front().bytes;
+            history.frames.pop_front();
         }
+        history.position -= next_key;
         
-        bool current = peek_cell(state, world_x, world_y);
-        if (current) {
-            if (neighbors < 2 || neighbors > 3) {
-                state.updates.emplace_back(world_x, world_y, false);
-            }
-        } else {
-            if (neighbors == 3) {
-                state.updates.emplace_back(world_x, world_y, true);
-            }
+        // 新的第一帧不再需要指向更早一代的差分
+        HistoryFrame& front = history.frames.front();
+        size_t delta_bytes = records_bytes(front.delta);
+        front.delta.clear();
+        front.bytes -= delta_bytes;
+        history.bytes -= delta_bytes;
+    }
+}
+
+void history_push(GameState &state, vector<ChunkRecord> delta, bool force_keyframe) {
+    History& history = state.history;
+    HistoryFrame frame;
+    frame.generation = state.generation;
+    frame.live_cell_count = life_population(state.world);
+    frame.delta = move(delta);
+    
+    // 上次裁剪后仍超限，说明最早的关键帧段无法丢弃，需要在这里开始新的关键帧段
+    int64_t first = history.frames.empty() ? state.generation : history.frames.front().generation;
+    frame.is_keyframe = force_keyframe || history.frames.empty() || history.bytes > history.max_bytes ||
+                        (state.generation - first) % history.keyframe_interval == 0;
+    if (frame.is_keyframe) {
+        frame.snapshot = take_snapshot(state);
+    }
+    frame.bytes = sizeof(HistoryFrame) + records_bytes(frame.delta) + records_bytes(frame.snapshot);
+    
+    history.bytes += frame.bytes;
+    history.frames.push_back(move(frame));
+    history.position = history.frames.size() - 1;
+    history_trim(state);
+    
+    // 一个关键帧都放不下，暂停记录
+    if (history.bytes > history.max_bytes && history.frames.size() == 1) {
+        history_reset(state);
+        history.suspended = true;
+    }
+}
+
+// 把世界的变化（本代的异或差分）发布给流服务器的客户端；镜像失效时改为发送完整快照
+void stream_publish(GameState &state, const vector<ChunkRecord>& records) {
+    if (!state.server) return;
+    if (state.server->wants_snapshot()) {
+        state.server->resync(take_snapshot(state), state.generation, life_population(state.world));
+    } else {
+        state.server->publish(records, state.generation, life_population(state.world));
+    }
+}
+
+// 有客户端观看时才需要收集差分
+bool stream_watching(GameState &state) {
+    return state.server && state.server->watching();
+}
+
+// 演算（或从历史重放）一代
+void step_generation(GameState &state) {
+    History& history = state.history;
+    if (!history_enabled(state)) {
+        vector<ChunkRecord> delta;
+        if (life_population(state.world) > 0) compute_generation(state, stream_watching(state) ? &delta : nullptr);
+        state.generation++;
+        stream_publish(state, delta);
+        return;
+    }
+    
+    if (history.frames.empty()) {
+        history_push(state, {}, true);
+    }
+    
+    // 回退之后再前进：直接重放已记录的差分
+    if (history.position + 1 < history.frames.size()) {
+        history.position++;
+        for (auto& record : history.frames[history.position].delta) {
+            xor_record(state, record);
         }
+        state.generation = history.frames[history.position].generation;
+        stream_publish(state, history.frames[history.position].delta);
+        return;
     }
     
-    // 应用更新
-    for (auto& update : state.updates) {
-        set_cell(state, get<0>(update), get<1>(update), get<2>(update));
+    vector<ChunkRecord> delta;
+    if (life_population(state.world) > 0) {
+        compute_generation(state, &delta);
+    }
+    state.generation++;
+    stream_publish(state, delta);
+    history_push(state, move(delta), false);
+}
+
+// 后退一代，历史不足时返回 false
+bool step_back(GameState &state) {
+    History& history = state.history;
+    if (history.frames.empty() || history.position == 0) return false;
+    
+    for (auto& record : history.frames[history.position].delta) {
+        xor_record(state, record);
+    }
+    history.position--;
+    state.generation = history.frames[history.position].generation;
+    stream_publish(state, history.frames[history.position + 1].delta);
+    return true;
+}
+
+// 在历史范围内跳转到第 target 代：取最近的关键帧再向前重放（或从当前位置直接走差分，取代价小的）
+// 超出历史范围时停在最近的一端，返回实际到达的代数
+int64_t seek_generation(GameState &state, int64_t target) {
+    History& history = state.history;
+    if (!history.frames.empty()) {
+        int64_t first = history.frames.front().generation;
+        int64_t last = history.frames.back().generation;
+        int64_t clamped = max(first, min(target, last));
+        
+        size_t index = static_cast<size_t>(clamped - first);
+        size_t key = index;
+        while (!history.frames[key].is_keyframe) key--;
+        
+        size_t walk = index > history.position ? index - history.position : history.position - index;
+        if (index - key + 1 < walk) {
+            restore_snapshot(state, history.frames[key].snapshot);
+            history.position = key;
+            state.generation = history.frames[key].generation;
+        }
+        while (history.position > index) step_back(state);
+        while (history.position < index) step_generation(state);
     }
+    return state.generation;
 }
 
-void show_loading(GameState &state) {
+struct FastForwardResult {
+    int64_t generations = 0;
+    double seconds = 0;
+    bool cancelled = false;
+};
+
+// 快进：后台线程连续演算，不绘制任何一代；界面线程以固定频率刷新进度并检查取消键
+// generations 为 0 表示不限代数，budget_seconds 为 0 表示不限时间（两者至少给一个）
+FastForwardResult fast_forward(GameState &state, int64_t generations, double budget_seconds, const char* title) {
+    PhaseTimer timer(state, PHASE_FAST_FORWARD);
+    FastForwardResult result;
+    Session& session = state.session;
+    if (session.replay) {
+        // 回放：按录制时实际完成的代数演算，不显示进度
+        if (session.diverged || session.next >= session.events.size() || session.events[session.next].type != 'f') {
+            session.diverged = true;
+            return result;
+        }
+        generations = session.events[session.next++].value;
+        budget_seconds = 0;
+        if (generations == 0) return result;
+    }
+    
+    atomic<int64_t> done{0};
+    atomic<bool> cancel{false};
+    bool finished = false;
+    mutex finished_mutex;
+    condition_variable finished_cv;
+    
+    auto start_time = chrono::steady_clock::now();
+    auto deadline = start_time + chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(budget_seconds > 0 ? budget_seconds : 1e9));
+    
+    thread worker([&] {
+        while ((generations == 0 || done < generations) && !cancel &&
+               (budget_seconds <= 0 || chrono::steady_clock::now() < deadline)) {
+            if (life_population(state.world) == 0 && generations > 0) {
+                // 空世界之后的每一代都一样，直接跳到终点；跳过的代数没有记录，历史要求代数连续，从终点重新开始
+                if (!state.history.frames.empty()) history_reset(state);
+                state.generation += generations - done;
+                done = generations;
+                stream_publish(state, {});
+                break;
+            }
+            if (life_population(state.world) == 0) break;
+            step_generation(state);
+            done++;
+        }
+        lock_guard<mutex> lock(finished_mutex);
+        finished = true;
+        finished_cv.notify_all();
+    });
+    
+    // 进度界面（只有这个线程调用 ncurses）
+    bool was_nodelay = is_nodelay(stdscr);
+    nodelay(stdscr, TRUE);
+    noecho();
     clear();
     int width = min(30, state.cols - 10);
     int start_col = (state.cols - width) / 2;
     int start_row = state.rows / 2;
+    const auto refresh_period = chrono::milliseconds(100);
     
-    mvprintw(start_row - 2, start_col, "Precomputing %d rounds...", state.precompute_rounds);
-    mvprintw(start_row, start_col - 1, "[");
-    mvprintw(start_row, start_col + width, "]");
-    refresh();
-    
-    int refresh_interval = max(1, state.precompute_rounds / 50);
-    
-    for (int i = 0; i < state.precompute_rounds; i++) {
-        compute_generation(state);
+    while (!session.replay) {
+        {
+            unique_lock<mutex> lock(finished_mutex);
+            if (finished_cv.wait_for(lock, refresh_period, [&] { return finished; })) break;
+        }
         
-        if (i % refresh_interval == 0) {
-            int progress = (i + 1) * width / state.precompute_rounds;
-            
-            for (int j = 0; j < progress; j++) {
-                mvaddch(start_row, start_col + j, '=' | A_REVERSE);
-            }
-            mvprintw(start_row + 2, start_col, "Progress: %d%%", 
-                     (i + 1) * 100 / state.precompute_rounds);
-            refresh();
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+        int64_t count = done;
+        double fraction = generations > 0 ? static_cast<double>(count) / generations
+                                          : elapsed / budget_seconds;
+        if (budget_seconds > 0) fraction = max(fraction, elapsed / budget_seconds);
+        int progress = static_cast<int>(min(1.0, fraction) * width);
+        
+        mvprintw(start_row - 2, start_col, "%s", title);
+        clrtoeol();
+        mvprintw(start_row, start_col - 1, "[");
+        for (int j = 0; j < width; j++) {
+            mvaddch(start_row, start_col + j, j < progress ? ('=' | A_REVERSE) : ' ');
+        }
+        mvprintw(start_row, start_col + width, "]");
+        mvprintw(start_row + 2, start_col, "Gen: %lld | %.1f gen/s | %.1fs", (long long)count,
+                 elapsed > 0 ? count / elapsed : 0.0, elapsed);
+        clrtoeol();
+        mvprintw(start_row + 3, start_col, "Press Q or ESC to cancel");
+        refresh();
+        
+        int ch = getch();
+        if (ch == 'q' || ch == 'Q' || ch == 27) {
+            cancel = true;
         }
     }
-    
-    for (int j = 0; j < width; j++) {
-        mvaddch(start_row, start_col + j, '=' | A_REVERSE);
+    worker.join();
+    nodelay(stdscr, was_nodelay);
+    if (session.record) {
+        fprintf(session.record, "f %lld\n", (long long)done.load());
+        fflush(session.record);
     }
-    mvprintw(start_row + 2, start_col, "Progress: 100%%");
-    refresh();
     
-    this_thread::sleep_for(chrono::milliseconds(200));
+    result.generations = done;
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    result.cancelled = cancel;
+    state.need_full_refresh = true;
+    return result;
+}
+
+// 在命令行上显示快进结果
+void print_fast_forward_result(GameState &state, const FastForwardResult& result) {
+    move(state.rows - 2, 0);
+    clrtoeol();
+    printw("%s %lld generations in %.2fs (%.1f gen/s), now at %lld",
+           result.cancelled ? "Cancelled after" : "Advanced",
+           (long long)result.generations, result.seconds,
+           result.seconds > 0 ? result.generations / result.seconds : 0.0,
+           (long long)state.generation);
+    refresh();
+}
+
+// 绘制块与屏幕相交的部分（演算中被释放的块没有活细胞，按空块绘制）
+void draw_chunk(GameState& state, const LifeKey& key) {
+    const int size = chunk_size(state);
+    int64_t world_start_x = key.x * size;
+    int64_t world_start_y = key.y * size;
+    int x0 = static_cast<int>(max<int64_t>(0, state.viewport_x - world_start_x));
+    int y0 = static_cast<int>(max<int64_t>(0, state.viewport_y - world_start_y));
+    int x1 = static_cast<int>(min<int64_t>(size, state.viewport_x + state.cols - world_start_x));
+    int y1 = static_cast<int>(min<int64_t>(size, state.viewport_y + state.rows - world_start_y));
     
-    for (int r = start_row - 2; r <= start_row + 2; r++) {
-        move(r, 0);
-        clrtoeol();
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            int screen_x = static_cast<int>(world_start_x + x - state.viewport_x);
+            int screen_y = static_cast<int>(world_start_y + y - state.viewport_y);
+            
+            if (peek_cell(state, world_start_x + x, world_start_y + y)) {
+                mvaddch(screen_y, screen_x, '#' | A_BOLD);
+            } else {
+                mvaddch(screen_y, screen_x, ' ');
+            }
+        }
+    }
+}
+
+// 向下取整的除法（环面中把坐标移到视口附近的周期）
+int64_t floor_div(int64_t a, int64_t b) {
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+bool matches_visible(const GameState &state) {
+    return !state.matches.empty() && state.match_generation == state.generation;
+}
+
+// 世界坐标是否落在某个查找结果的包围盒内（环面按周期回绕）
+bool in_match(const GameState &state, int64_t world_x, int64_t world_y) {
+    if (!matches_visible(state)) return false;
+    bool torus = life_topology(state.world) == LIFE_TORUS;
+    int64_t width = life_width(state.world), height = life_height(state.world);
+    for (const LifeMatch& match : state.matches) {
+        int64_t dx = world_x - match.x, dy = world_y - match.y;
+        if (torus) {
+            dx -= floor_div(dx, width) * width;
+            dy -= floor_div(dy, height) * height;
+        }
+        if (dx >= 0 && dx < match.width && dy >= 0 && dy < match.height) return true;
     }
-    refresh();
+    return false;
+}
+
+// 查找结果中的格子：活细胞画为 '@'，包围盒内的死细胞画为 '.'
+chtype match_glyph(bool alive) {
+    return alive ? ('@' | A_BOLD) : '.';
 }
 
-void draw_chunk(GameState& state, int chunk_x, int chunk_y, Chunk* chunk) {
-    int world_start_x = chunk_x * CHUNK_SIZE;
-    int world_start_y = chunk_y * CHUNK_SIZE;
+// 在视口中标出查找结果（环面中与视口相交的每个周期都标出）
+void draw_matches(GameState &state) {
+    if (!matches_visible(state)) return;
+    bool torus = life_topology(state.world) == LIFE_TORUS;
+    int64_t period_x = torus ? life_width(state.world) : INT64_MAX;
+    int64_t period_y = torus ? life_height(state.world) : INT64_MAX;
     
-    for (int y = 0; y < CHUNK_SIZE; y++) {
-        for (int x = 0; x < CHUNK_SIZE; x++) {
-            int screen_x = world_start_x + x - state.viewport_x;
-            int screen_y = world_start_y + y - state.viewport_y;
-            
-            if (screen_x >= 0 && screen_x < state.cols && 
-                screen_y >= 0 && screen_y < state.rows) {
-                
-                if (chunk->get_bit(x, y)) {
-                    mvaddch(screen_y, screen_x, '#' | A_BOLD);
-                } else {
-                    mvaddch(screen_y, screen_x, ' ');
+    for (const LifeMatch& match : state.matches) {
+        int64_t first_x = match.x, first_y = match.y;
+        if (torus) {
+            first_x += floor_div(state.viewport_x - match.x, period_x) * period_x;
+            first_y += floor_div(state.viewport_y - match.y, period_y) * period_y;
+        }
+        for (int64_t box_y = first_y; box_y < state.viewport_y + state.rows; box_y += period_y) {
+            for (int64_t box_x = first_x; box_x < state.viewport_x + state.cols; box_x += period_x) {
+                int64_t x0 = max(box_x, state.viewport_x), x1 = min(box_x + match.width, state.viewport_x + state.cols);
+                int64_t y0 = max(box_y, state.viewport_y), y1 = min(box_y + match.height, state.viewport_y + state.rows);
+                for (int64_t y = y0; y < y1; y++) {
+                    for (int64_t x = x0; x < x1; x++) {
+                        mvaddch(static_cast<int>(y - state.viewport_y), static_cast<int>(x - state.viewport_x),
+                                match_glyph(peek_cell(state, x, y)));
+                    }
                 }
+                if (!torus) break;
             }
+            if (!torus) break;
         }
     }
-    
-    chunk->dirty = false;
 }
 
 void draw_cursor(GameState &state) {
     if (state.prev_cursor_screen_y >= 0 && state.prev_cursor_screen_y < state.rows && 
         state.prev_cursor_screen_x >= 0 && state.prev_cursor_screen_x < state.cols) {
         
-        int world_x = state.prev_cursor_screen_x + state.viewport_x;
-        int world_y = state.prev_cursor_screen_y + state.viewport_y;
+        int64_t world_x = state.prev_cursor_screen_x + state.viewport_x;
+        int64_t world_y = state.prev_cursor_screen_y + state.viewport_y;
         
         bool isAlive = peek_cell(state, world_x, world_y);
         chtype ch = isAlive ? '#' : ' ';
+        if (in_match(state, world_x, world_y)) ch = match_glyph(isAlive);
         
         mvaddch(state.prev_cursor_screen_y, state.prev_cursor_screen_x, ch);
     }
@@ -394,8 +1473,8 @@ void draw_cursor(GameState &state) {
     if (state.cursor_screen_y >= 0 && state.cursor_screen_y < state.rows && 
         state.cursor_screen_x >= 0 && state.cursor_screen_x < state.cols) {
         
-        int world_x = state.cursor_screen_x + state.viewport_x;
-        int world_y = state.cursor_screen_y + state.viewport_y;
+        int64_t world_x = state.cursor_screen_x + state.viewport_x;
+        int64_t world_y = state.cursor_screen_y + state.viewport_y;
         
         bool isAlive = peek_cell(state, world_x, world_y);
         chtype ch = isAlive ? '#' : ' ';
@@ -404,138 +1483,71 @@ void draw_cursor(GameState &state) {
     }
 }
 
+// 逐格绘制整个视口（ncurses 只输出有差异的字符）
 void draw_all_visible_chunks(GameState &state) {
-    int min_world_x = state.viewport_x;
-    int min_world_y = state.viewport_y;
-    int max_world_x = state.viewport_x + state.cols;
-    int max_world_y = state.viewport_y + state.rows;
-    
-    int min_chunk_x = min_world_x / CHUNK_SIZE;
-    int min_chunk_y = min_world_y / CHUNK_SIZE;
-    int max_chunk_x = (max_world_x + CHUNK_SIZE - 1) / CHUNK_SIZE;
-    int max_chunk_y = (max_world_y + CHUNK_SIZE - 1) / CHUNK_SIZE;
-    
-    for (int chunk_y = min_chunk_y; chunk_y <= max_chunk_y; chunk_y++) {
-        if (state.world.find(chunk_y) == state.world.end()) continue;
-        
-        for (int chunk_x = min_chunk_x; chunk_x <= max_chunk_x; chunk_x++) {
-            if (state.world[chunk_y].find(chunk_x) == state.world[chunk_y].end()) continue;
-            
-            draw_chunk(state, chunk_x, chunk_y, state.world[chunk_y][chunk_x]);
+    for (int screen_y = 0; screen_y < state.rows; screen_y++) {
+        for (int screen_x = 0; screen_x < state.cols; screen_x++) {
+            if (peek_cell(state, state.viewport_x + screen_x, state.viewport_y + screen_y)) {
+                mvaddch(screen_y, screen_x, '#' | A_BOLD);
+            } else {
+                mvaddch(screen_y, screen_x, ' ');
+            }
         }
     }
 }
 
-enum CommandResult { SUCCESS, ERROR, CANCEL };
-
-CommandResult save_world(GameState &state, const string& filename) {
-    ofstream file(filename);
-    if (!file.is_open()) {
-        return ERROR;
-    }
-
-    // 写入元数据
-    file << "#Life 1.06\n";
-    file << "# Generated by LifeGame\n";
-    file << "# Viewport: " << state.viewport_x << " " << state.viewport_y << "\n";
-
-    // 写入所有活细胞坐标
-    for (const auto& [chunk_y, row] : state.world) {
-        for (const auto& [chunk_x, chunk] : row) {
-            if (!chunk || chunk->live_count == 0) continue;
-            
-            int world_base_x = chunk_x * CHUNK_SIZE;
-            int world_base_y = chunk_y * CHUNK_SIZE;
-            
-            for (int y = 0; y < CHUNK_SIZE; y++) {
-                for (int x = 0; x < CHUNK_SIZE; x++) {
-                    if (chunk->get_bit(x, y)) {
-                        file << world_base_x + x << " " << world_base_y + y << "\n";
-                    }
-                }
-            }
+// 只重绘本帧变化过的块；固定尺寸世界没有块，有变化时重绘整个视口
+void draw_dirty_chunks(GameState &state) {
+    size_t count;
+    const LifeKey* dirty = life_dirty(state.world, &count);
+    if (life_topology(state.world) != LIFE_PLANE) {
+        if (count > 0) draw_all_visible_chunks(state);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            draw_chunk(state, dirty[i]);
         }
     }
+    life_clear_dirty(state.world);
+}
 
-    file.close();
-    return SUCCESS;
+CommandResult save_world(GameState &state, const string& filename) {
+    // 写入元数据，活细胞坐标由核心写入
+    ostringstream header;
+    header << "# Generated by LifeGame\n";
+    header << "# Viewport: " << state.viewport_x << " " << state.viewport_y << "\n";
+    
+    return life_save(state.world, filename.c_str(), header.str().c_str()) ? SUCCESS : ERROR;
 }
 
 CommandResult load_world(GameState &state, const string& filename) {
-    ifstream file(filename);
-    if (!file.is_open()) {
-        return ERROR;
-    }
-
-    // 清除当前世界
-    for (auto& [y, row] : state.world) {
-        for (auto& [x, chunk] : row) {
-            delete chunk;
-        }
-    }
-    state.world.clear();
-    state.live_cell_count = 0;
-
-    string line;
-    int line_num = 0;
-    bool viewport_loaded = false;
-
-    while (getline(file, line)) {
-        line_num++;
-        // 跳过注释行
-        if (line.empty() || line[0] == '#') {
-            // 尝试解析视口信息
-            if (line.find("# Viewport:") != string::npos) {
-                istringstream iss(line.substr(11));
-                if (iss >> state.viewport_x >> state.viewport_y) {
-                    viewport_loaded = true;
-                }
-            }
-            continue;
-        }
-
-        // 解析坐标
-        istringstream iss(line);
-        int x, y;
-        if (!(iss >> x >> y)) {
-            // 格式错误
-            file.close();
-            return ERROR;
+    // 注释行中的视口信息
+    struct ViewportReader {
+        GameState* state;
+        bool loaded;
+    } reader{&state, false};
+    
+    bool loaded = life_load(state.world, filename.c_str(), [](void* ctx, const char* line) {
+        ViewportReader& reader = *static_cast<ViewportReader*>(ctx);
+        const char* viewport = strstr(line, "# Viewport:");
+        if (!viewport) return;
+        istringstream iss(viewport + 11);
+        int64_t x, y;
+        if (iss >> x >> y) {
+            reader.state->viewport_x = x;
+            reader.state->viewport_y = y;
+            reader.loaded = true;
         }
-
-        set_cell(state, x, y, true);
+    }, &reader);
+    if (!loaded) {
+        return ERROR;
     }
-
-    file.close();
     
     // 如果文件中没有视口信息，将视口中心设置为活细胞的中心
-    if (!viewport_loaded && state.live_cell_count > 0) {
-        long long sum_x = 0, sum_y = 0;
-        int count = 0;
-        
-        for (const auto& [chunk_y, row] : state.world) {
-            for (const auto& [chunk_x, chunk] : row) {
-                if (!chunk || chunk->live_count == 0) continue;
-                
-                int world_base_x = chunk_x * CHUNK_SIZE;
-                int world_base_y = chunk_y * CHUNK_SIZE;
-                
-                for (int y = 0; y < CHUNK_SIZE; y++) {
-                    for (int x = 0; x < CHUNK_SIZE; x++) {
-                        if (chunk->get_bit(x, y)) {
-                            sum_x += world_base_x + x;
-                            sum_y += world_base_y + y;
-                            count++;
-                        }
-                    }
-                }
-            }
-        }
-        
-        if (count > 0) {
-            state.viewport_x = static_cast<int>(sum_x / count) - state.cols / 2;
-            state.viewport_y = static_cast<int>(sum_y / count) - state.rows / 2;
-        }
+    if (!reader.loaded && life_population(state.world) > 0) {
+        LifeStats stats;
+        life_stats(state.world, &stats);
+        state.viewport_x = stats.centroid_x - state.cols / 2;
+        state.viewport_y = stats.centroid_y - state.rows / 2;
     }
     
     state.need_full_refresh = true;
@@ -544,41 +1556,40 @@ CommandResult load_world(GameState &state, const string& filename) {
 
 void design_mode(GameState &state) {
     curs_set(1);
-    state.dirty_chunks.clear();
+    life_clear_dirty(state.world);
+    // 流服务器开启时定时醒来，把编辑和新客户端需要的快照发布出去
+    if (state.server) timeout(200);
     
     state.prev_cursor_screen_x = state.cursor_screen_x;
     state.prev_cursor_screen_y = state.cursor_screen_y;
     
     while (state.mode == DESIGN) {
+        stream_publish(state, {});
+        PhaseTimer draw_timer(state, PHASE_DRAW);
         if (state.viewport_changed || state.need_full_refresh) {
             clear();
             draw_all_visible_chunks(state);
+            draw_matches(state);
             state.viewport_changed = false;
             state.need_full_refresh = false;
-            state.dirty_chunks.clear();
+            life_clear_dirty(state.world);
         } else {
-            for (auto& chunk_pos : state.dirty_chunks) {
-                int chunk_x = chunk_pos.first;
-                int chunk_y = chunk_pos.second;
-                if (state.world.find(chunk_y) != state.world.end() && 
-                    state.world[chunk_y].find(chunk_x) != state.world[chunk_y].end()) {
-                    draw_chunk(state, chunk_x, chunk_y, state.world[chunk_y][chunk_x]);
-                }
-            }
-            state.dirty_chunks.clear();
+            draw_dirty_chunks(state);
         }
         
         draw_cursor(state);
         
-        mvprintw(0, 0, "DESIGN MODE - Cells: %d | Cursor: (%d, %d) | Viewport: (%d, %d)", 
-                 state.live_cell_count, 
-                 state.cursor_screen_x + state.viewport_x, 
-                 state.cursor_screen_y + state.viewport_y,
-                 state.viewport_x, state.viewport_y);
+        mvprintw(0, 0, "DESIGN MODE - Cells: %lld | %s | Cursor: (%lld, %lld) | Viewport: (%lld, %lld) | %s", 
+                 (long long)life_population(state.world), box_label(state).c_str(), 
+                 (long long)(state.cursor_screen_x + state.viewport_x), 
+                 (long long)(state.cursor_screen_y + state.viewport_y),
+                 (long long)state.viewport_x, (long long)state.viewport_y,
+                 topology_label(state).c_str());
         clrtoeol();
         refresh();
+        draw_timer.stop();
         
-        int ch = getch();
+        int ch = read_key(state);
         switch (ch) {
             case 'q': case 'Q':
                 state.running = false;
@@ -590,7 +1601,8 @@ void design_mode(GameState &state) {
             case 'y': case 'Y':
                 state.mode = PLAY;
                 if (state.precompute) {
-                    show_loading(state);
+                    string title = "Precomputing " + to_string(state.precompute_rounds) + " rounds...";
+                    fast_forward(state, state.precompute_rounds, 0, title.c_str());
                 }
                 return;
             case 'w': case 'W':
@@ -623,10 +1635,11 @@ void design_mode(GameState &state) {
                 break;
             case '\n': case ' ':
             {
-                int world_x = state.cursor_screen_x + state.viewport_x;
-                int world_y = state.cursor_screen_y + state.viewport_y;
+                int64_t world_x = state.cursor_screen_x + state.viewport_x;
+                int64_t world_y = state.cursor_screen_y + state.viewport_y;
                 bool current = peek_cell(state, world_x, world_y);
                 set_cell(state, world_x, world_y, !current);
+                history_reset(state);
                 break;
             }
         }
@@ -644,13 +1657,14 @@ void command_mode(GameState &state) {
         move(state.rows - 1, 5 + state.command_str.size());
         refresh();
         
-        int ch = getch();
+        int ch = read_key(state);
         switch (ch) {
             case 27: // ESC
                 state.mode = DESIGN;
                 break;
             case '\n': // ENTER
             {
+                PhaseTimer timer(state, PHASE_COMMAND);
                 istringstream iss(state.command_str);
                 string cmd;
                 iss >> cmd;
@@ -671,7 +1685,7 @@ void command_mode(GameState &state) {
                         printw("Error saving to %s", filename.c_str());
                     }
                     refresh();
-                    this_thread::sleep_for(chrono::seconds(1));
+                    hold_message(state, 1);
                 }
                 else if (cmd == "load" || cmd == "LOAD") {
                     string filename;
@@ -683,59 +1697,268 @@ void command_mode(GameState &state) {
                     auto result = load_world(state, filename);
                     move(state.rows - 2, 0);
                     clrtoeol();
+                    state.generation = 0;
+                    history_reset(state);
                     if (result == SUCCESS) {
                         printw("Loaded from %s", filename.c_str());
                     } else {
                         printw("Error loading from %s", filename.c_str());
                     }
                     refresh();
-                    this_thread::sleep_for(chrono::seconds(1));
+                    hold_message(state, 1);
                 }
                 else if (cmd == "clear" || cmd == "CLEAR") {
-                    // 清空世界
-                    for (auto& [y, row] : state.world) {
-                        for (auto& [x, chunk] : row) {
-                            delete chunk;
+                    int64_t x, y, w, h;
+                    move(state.rows - 2, 0);
+                    clrtoeol();
+                    bool has_region = static_cast<bool>(iss >> x >> y >> w >> h);
+                    if (has_region && !valid_region(x, y, w, h)) {
+                        printw("Usage: clear [<x> <y> <width> <height>]");
+                    } else {
+                        if (has_region) {
+                            // 清除矩形区域
+                            int64_t count = -region_op(state, REGION_CLEAR, x, y, w, h);
+                            printw("Cleared %lld cells in area [%lld, %lld] to [%lld, %lld]",
+                                   (long long)count, (long long)x, (long long)y,
+                                   (long long)(x + w - 1), (long long)(y + h - 1));
+                        } else {
+                            // 清空世界
+                            clear_world(state);
+                            state.generation = 0;
+                            printw("World cleared");
                         }
+                        history_reset(state);
+                        state.need_full_refresh = true;
                     }
-                    state.world.clear();
-                    state.live_cell_count = 0;
-                    state.need_full_refresh = true;
+                    refresh();
+                    hold_message(state, 1);
+                }
+                else if (cmd == "fill" || cmd == "FILL" || cmd == "invert" || cmd == "INVERT") {
+                    bool fill = (cmd == "fill" || cmd == "FILL");
+                    int64_t x, y, w, h;
                     move(state.rows - 2, 0);
                     clrtoeol();
-                    printw("World cleared");
+                    if (iss >> x >> y >> w >> h && valid_region(x, y, w, h)) {
+                        int64_t delta = region_op(state, fill ? REGION_FILL : REGION_INVERT, x, y, w, h);
+                        history_reset(state);
+                        state.need_full_refresh = true;
+                        printw("%s area [%lld, %lld] to [%lld, %lld], cells %+lld",
+                               fill ? "Filled" : "Inverted", (long long)x, (long long)y,
+                               (long long)(x + w - 1), (long long)(y + h - 1), (long long)delta);
+                    } else {
+                        printw("Usage: %s <x> <y> <width> <height>", fill ? "fill" : "invert");
+                    }
                     refresh();
-                    this_thread::sleep_for(chrono::seconds(1));
+                    hold_message(state, 1);
                 }
                 else if (cmd == "rand" || cmd == "RAND") {
-                    int x, y, w, h;
-                    if (iss >> x >> y >> w >> h) {
-                        int count = 0;
-                        for (int i = y; i < y + h; i++) {
-                            for (int j = x; j < x + w; j++) {
-                                if (rand() % 3 == 0) {
-                                    set_cell(state, j, i, true);
-                                    count++;
-                                }
-                            }
-                        }
+                    int64_t x, y, w, h;
+                    if (iss >> x >> y >> w >> h && valid_region(x, y, w, h)) {
+                        // 可选密度百分比，默认约1/3
+                        int percent;
+                        int density = (iss >> percent) ? max(0, min(100, percent)) * 256 / 100 : 85;
+                        int64_t count = region_op(state, REGION_RANDOM, x, y, w, h, density);
+                        history_reset(state);
                         state.need_full_refresh = true;
                         
                         // 显示生成结果
                         move(state.rows - 2, 0);
                         clrtoeol();
-                        printw("Generated %d random cells in area [%d, %d] to [%d, %d]", 
-                               count, x, y, x + w - 1, y + h - 1);
+                        printw("Generated %lld random cells in area [%lld, %lld] to [%lld, %lld]", 
+                               (long long)count, (long long)x, (long long)y,
+                               (long long)(x + w - 1), (long long)(y + h - 1));
                         refresh();
-                        this_thread::sleep_for(chrono::seconds(2));
+                        hold_message(state, 2);
                     } else {
                         // 参数错误提示
                         move(state.rows - 2, 0);
                         clrtoeol();
-                        printw("Usage: rand <x> <y> <width> <height>");
+                        printw("Usage: rand <x> <y> <width> <height> [density%%]");
+                        refresh();
+                        hold_message(state, 1);
+                    }
+                }
+                else if (cmd == "copy" || cmd == "COPY") {
+                    int64_t x, y, w, h;
+                    move(state.rows - 2, 0);
+                    clrtoeol();
+                    if (iss >> x >> y >> w >> h && valid_region(x, y, w, h)) {
+                        copy_region(state, x, y, w, h);
+                        printw("Copied %lldx%lld area at [%lld, %lld]",
+                               (long long)w, (long long)h, (long long)x, (long long)y);
+                    } else {
+                        printw("Usage: copy <x> <y> <width> <height>");
+                    }
+                    refresh();
+                    hold_message(state, 1);
+                }
+                else if (cmd == "paste" || cmd == "PASTE") {
+                    int64_t x, y;
+                    string filename;
+                    move(state.rows - 2, 0);
+                    clrtoeol();
+                    if (iss >> x >> y) {
+                        // 指定文件时盖印文件中的图案，否则盖印剪贴板
+                        Pattern file_pattern;
+                        const Pattern* pattern = &state.clipboard;
+                        if (iss >> filename) {
+                            if (load_pattern(filename, file_pattern) != SUCCESS) {
+                                printw("Error loading from %s", filename.c_str());
+                                pattern = nullptr;
+                            } else {
+                                pattern = &file_pattern;
+                            }
+                        }
+                        if (pattern) {
+                            int64_t count = paste_pattern(state, *pattern, x, y);
+                            history_reset(state);
+                            state.need_full_refresh = true;
+                            printw("Pasted %lldx%lld pattern at [%lld, %lld], %lld new cells",
+                                   (long long)pattern->width, (long long)pattern->height,
+                                   (long long)x, (long long)y, (long long)count);
+                        }
+                    } else {
+                        printw("Usage: paste <x> <y> [file]");
+                    }
+                    refresh();
+                    hold_message(state, 1);
+                }
+                else if (cmd == "goto" || cmd == "GOTO") {
+                    int64_t target;
+                    move(state.rows - 2, 0);
+                    clrtoeol();
+                    if (iss >> target && target >= 0) {
+                        int64_t reached = seek_generation(state, target);
+                        state.need_full_refresh = true;
+                        if (reached < target) {
+                            // 超出历史末尾：快进剩下的代数
+                            string title = "Advancing to generation " + to_string(target) + "...";
+                            auto result = fast_forward(state, target - reached, 0, title.c_str());
+                            print_fast_forward_result(state, result);
+                        } else if (reached == target) {
+                            printw("At generation %lld", (long long)reached);
+                        } else {
+                            printw("Generation %lld is no longer in history, at %lld",
+                                   (long long)target, (long long)reached);
+                        }
+                    } else {
+                        printw("Usage: goto <generation>");
+                    }
+                    refresh();
+                    hold_message(state, 1);
+                }
+                else if (cmd == "find" || cmd == "FIND") {
+                    // find <文件>：查找图案的所有出现（8个朝向）；不带参数时跳到下一处
+                    string filename;
+                    iss >> filename;
+                    move(state.rows - 2, 0);
+                    clrtoeol();
+                    if (filename.empty()) {
+                        if (matches_visible(state)) {
+                            state.match_index = (state.match_index + 1) % state.matches.size();
+                            const LifeMatch& match = state.matches[state.match_index];
+                            center_viewport(state, match.x + match.width / 2, match.y + match.height / 2);
+                            printw("Match %zu/%zu at (%lld, %lld)", state.match_index + 1, state.matches.size(),
+                                   (long long)match.x, (long long)match.y);
+                        } else {
+                            printw("Usage: find <file>");
+                        }
+                    } else {
+                        Pattern pattern;
+                        int64_t count = -1;
+                        if (load_pattern(filename, pattern) == SUCCESS && pattern.width > 0) {
+                            state.matches.clear();
+                            count = find_pattern(state, pattern);
+                        }
+                        state.need_full_refresh = true;
+                        if (count < 0) {
+                            printw("Error loading pattern from %s (at most %dx%d cells)", filename.c_str(),
+                                   LIFE_MAX_FIND, LIFE_MAX_FIND);
+                        } else if (count == 0) {
+                            printw("No matches for %s", filename.c_str());
+                        } else {
+                            // 视口移到第一处，命令行列出能放下的坐标
+                            const LifeMatch& first = state.matches[0];
+                            center_viewport(state, first.x + first.width / 2, first.y + first.height / 2);
+                            string list = "Found " + to_string(count) + " matches:";
+                            size_t shown = 0;
+                            for (; shown < state.matches.size(); shown++) {
+                                string item = " (" + to_string(state.matches[shown].x) + ", " +
+                                              to_string(state.matches[shown].y) + ")";
+                                if (list.size() + item.size() + 4 > static_cast<size_t>(state.cols)) break;
+                                list += item;
+                            }
+                            if (shown < state.matches.size()) list += " ...";
+                            printw("%s", list.c_str());
+                        }
+                    }
+                    refresh();
+                    hold_message(state, 2);
+                }
+                else if (cmd == "fit" || cmd == "FIT") {
+                    // fit：视口移到活细胞包围盒的中心
+                    move(state.rows - 2, 0);
+                    clrtoeol();
+                    LifeStats stats;
+                    life_stats(state.world, &stats);
+                    if (stats.population == 0) {
+                        printw("World is empty");
+                    } else {
+                        int64_t width = stats.max_x - stats.min_x + 1, height = stats.max_y - stats.min_y + 1;
+                        center_viewport(state, stats.min_x + (width - 1) / 2, stats.min_y + (height - 1) / 2);
+                        printw("Box: %lldx%lld at (%lld, %lld) | Centroid: (%lld, %lld)%s",
+                               (long long)width, (long long)height, (long long)stats.min_x, (long long)stats.min_y,
+                               (long long)stats.centroid_x, (long long)stats.centroid_y,
+                               width > state.cols || height > state.rows ? " | Larger than viewport" : "");
+                    }
+                    refresh();
+                    hold_message(state, 1);
+                }
+                else if (cmd == "rule" || cmd == "RULE") {
+                    string rule;
+                    iss >> rule;
+                    move(state.rows - 2, 0);
+                    clrtoeol();
+                    if (rule.empty()) {
+                        printw("Rule: %s", life_rule(state.world));
+                    } else if (life_set_rule(state.world, rule.c_str())) {
+                        // 旧历史按旧规则演算，不能再向前重放
+                        history_reset(state);
+                        printw("Rule: %s", life_rule(state.world));
+                    } else {
+                        printw("Invalid rule: %s", rule.c_str());
+                    }
+                    refresh();
+                    hold_message(state, 1);
+                }
+                else if (cmd == "ff" || cmd == "FF") {
+                    // ff <代数> [秒数s]，或 ff <秒数s>：在时间预算内尽量多演算
+                    int64_t generations = 0;
+                    double budget = 0;
+                    string arg;
+                    bool valid = true;
+                    while (iss >> arg) {
+                        char* end;
+                        if (arg.back() == 's' || arg.back() == 'S') {
+                            budget = strtod(arg.c_str(), &end);
+                            valid &= (end == arg.c_str() + arg.size() - 1 && budget > 0);
+                        } else {
+                            generations = strtoll(arg.c_str(), &end, 10);
+                            valid &= (*end == '\0' && generations > 0);
+                        }
+                    }
+                    move(state.rows - 2, 0);
+                    clrtoeol();
+                    if (valid && (generations > 0 || budget > 0)) {
+                        string title = generations > 0 ? "Fast-forwarding " + to_string(generations) + " generations..."
+                                                       : "Fast-forwarding...";
+                        auto result = fast_forward(state, generations, budget, title.c_str());
+                        print_fast_forward_result(state, result);
+                    } else {
+                        printw("Usage: ff <generations> [<seconds>s] | ff <seconds>s");
                         refresh();
-                        this_thread::sleep_for(chrono::seconds(1));
                     }
+                    hold_message(state, 2);
                 }
                 else {
                     // 未知命令提示
@@ -743,7 +1966,7 @@ void command_mode(GameState &state) {
                     clrtoeol();
                     printw("Unknown command: %s", cmd.c_str());
                     refresh();
-                    this_thread::sleep_for(chrono::seconds(1));
+                    hold_message(state, 1);
                 }
                 
                 state.mode = DESIGN;
@@ -768,18 +1991,20 @@ void command_mode(GameState &state) {
 void play_mode(GameState &state) {
     curs_set(0);
     nodelay(stdscr, TRUE);
-    state.dirty_chunks.clear();
+    life_clear_dirty(state.world);
     
-    int generation_count = 0;
+    bool paused = false;
     int frames_skipped = 0;
     const int max_skip_frames = 3;
     
     while (state.mode == PLAY) {
         auto start_time = chrono::steady_clock::now();
         
-        if (state.live_cell_count > 0) {
-            compute_generation(state);
-            generation_count++;
+        if (!paused && life_population(state.world) > 0) {
+            PhaseTimer timer(state, PHASE_COMPUTE);
+            step_generation(state);
+        } else {
+            stream_publish(state, {});
         }
         
         auto compute_time = chrono::steady_clock::now();
@@ -795,35 +2020,36 @@ void play_mode(GameState &state) {
         }
         
         if (should_draw) {
+            PhaseTimer draw_timer(state, PHASE_DRAW);
             if (state.viewport_changed || state.need_full_refresh) {
                 clear();
                 draw_all_visible_chunks(state);
                 state.viewport_changed = false;
                 state.need_full_refresh = false;
-                state.dirty_chunks.clear();
+                life_clear_dirty(state.world);
             } else {
-                for (auto& chunk_pos : state.dirty_chunks) {
-                    int chunk_x = chunk_pos.first;
-                    int chunk_y = chunk_pos.second;
-                    if (state.world.find(chunk_y) != state.world.end() && 
-                        state.world[chunk_y].find(chunk_x) != state.world[chunk_y].end()) {
-                        draw_chunk(state, chunk_x, chunk_y, state.world[chunk_y][chunk_x]);
-                    }
-                }
-                state.dirty_chunks.clear();
+                draw_dirty_chunks(state);
             }
             
             auto draw_time = chrono::steady_clock::now();
             auto compute_duration = chrono::duration_cast<chrono::milliseconds>(compute_time - start_time);
             auto draw_duration = chrono::duration_cast<chrono::milliseconds>(draw_time - compute_time);
             
-            mvprintw(0, 0, "PLAY MODE - Gen: %d, Cells: %d | Compute: %lldms | Draw: %lldms", 
-                     generation_count, state.live_cell_count, compute_duration.count(), draw_duration.count());
+            mvprintw(0, 0, "PLAY MODE - Gen: %lld, Cells: %lld | %s | Compute: %lldms | Draw: %lldms", 
+                     (long long)state.generation, (long long)life_population(state.world), box_label(state).c_str(),
+                     (long long)compute_duration.count(), (long long)draw_duration.count());
+            if (!state.history.frames.empty()) {
+                printw(" | History: %lld-%lld (%.1fMB)",
+                       (long long)state.history.frames.front().generation,
+                       (long long)state.history.frames.back().generation,
+                       state.history.bytes / 1048576.0);
+            }
+            if (paused) printw(" [PAUSED]");
             clrtoeol();
             refresh();
         }
         
-        int ch = getch();
+        int ch = read_key(state);
         if (ch == 'q' || ch == 'Q') {
             state.mode = DESIGN;
         } else if (ch == 'w' || ch == 'W') {
@@ -838,20 +2064,270 @@ void play_mode(GameState &state) {
         } else if (ch == 'd' || ch == 'D') {
             state.viewport_x++;
             state.viewport_changed = true;
+        } else if (ch == 'p' || ch == 'P' || ch == ' ') {
+            paused = !paused;
+        } else if (ch == ',' || ch == '<') {
+            // 后退 1/10 代（自动暂停）
+            paused = true;
+            for (int i = 0; i < (ch == '<' ? 10 : 1); i++) {
+                if (!step_back(state)) break;
+            }
+        } else if (ch == '.' || ch == '>') {
+            // 前进 1/10 代（自动暂停）
+            paused = true;
+            for (int i = 0; i < (ch == '>' ? 10 : 1); i++) {
+                step_generation(state);
+            }
         }
         
         auto frame_time = chrono::duration_cast<chrono::milliseconds>(
             chrono::steady_clock::now() - start_time).count();
         
         int delay = max(0, 100 - (int)frame_time);
-        this_thread::sleep_for(chrono::milliseconds(delay));
+        if (!state.session.replay) this_thread::sleep_for(chrono::milliseconds(delay));
     }
     
     nodelay(stdscr, FALSE);
 }
 
-int main(int argc, char** argv) {
-    initscr();
+// 解析流服务器发来的一条消息，不完整时返回0，格式错误时返回 SIZE_MAX，否则返回消息长度
+size_t parse_stream_message(const string& in, size_t pos, LifeKey& key, vector<uint64_t>& bits) {
+    const char* data = in.data() + pos;
+    size_t available = in.size() - pos;
+    switch (data[0]) {
+        case 'H': return available >= 22 ? 22 : 0;
+        case 'G': return available >= 17 ? 17 : 0;
+        case 'C': {
+            if (available < 25) return 0;
+            key.x = static_cast<int64_t>(get_le(data + 1, 8));
+            key.y = static_cast<int64_t>(get_le(data + 9, 8));
+            uint64_t words = get_le(data + 17, 4), runs = get_le(data + 21, 4);
+            if (words > (1 << 20)) return SIZE_MAX;
+            bits.assign(words, 0);
+            size_t offset = 25;
+            uint64_t k = 0;
+            for (uint64_t r = 0; r < runs; r++) {
+                if (available < offset + 8) return 0;
+                uint64_t skip = get_le(data + offset, 4), count = get_le(data + offset + 4, 4);
+                offset += 8;
+                if (k + skip + count > words) return SIZE_MAX;
+                if (available < offset + count * 8) return 0;
+                for (k += skip; count > 0; count--, k++, offset += 8) bits[k] = get_le(data + offset, 8);
+            }
+            return offset;
+        }
+    }
+    return SIZE_MAX;
+}
+
+// 远程观看（--watch）：订阅当前视口，把收到的异或差分计入本地世界后绘制；wasd 移动视口，Q 退出
+void watch_mode(GameState &state, int fd, const string& address) {
+    state.rows = LINES;
+    state.cols = COLS;
+    curs_set(0);
+    nodelay(stdscr, TRUE);
+    
+    string in;
+    LifeKey key;
+    vector<uint64_t> bits;
+    bool connected = true, ready = false, subscribe = true, frame = false;
+    int64_t generation = 0, population = 0, frames = 0;
+    size_t received = 0;
+    
+    while (true) {
+        auto start_time = chrono::steady_clock::now();
+        if (ready && subscribe) {
+            string message(1, 'V');
+            put_le(message, static_cast<uint64_t>(state.viewport_x), 8);
+            put_le(message, static_cast<uint64_t>(state.viewport_y), 8);
+            put_le(message, static_cast<uint64_t>(state.viewport_x + state.cols), 8);
+            put_le(message, static_cast<uint64_t>(state.viewport_y + state.rows), 8);
+            if (send(fd, message.data(), message.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(message.size())) {
+                connected = false;
+            }
+            subscribe = false;
+        }
+        
+        if (connected) {
+            pollfd events{fd, POLLIN, 0};
+            poll(&events, 1, 50);
+            char buffer[65536];
+            ssize_t n;
+            while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+                in.append(buffer, static_cast<size_t>(n));
+                received += static_cast<size_t>(n);
+            }
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) connected = false;
+        } else {
+            this_thread::sleep_for(chrono::milliseconds(50));
+        }
+        
+        size_t pos = 0;
+        while (connected && pos < in.size()) {
+            size_t length = parse_stream_message(in, pos, key, bits);
+            if (length == 0) break;
+            if (length == SIZE_MAX) {
+                connected = false;
+                break;
+            }
+            const char* data = in.data() + pos;
+            if (data[0] == 'H') {
+                // 本地世界与服务器使用相同的拓扑和块宽度，记录才能直接异或进来
+                LifeTopology topology = static_cast<LifeTopology>(data[1]);
+                bool ok = topology == LIFE_PLANE
+                    ? life_set_chunk_size(state.world, static_cast<int>(get_le(data + 2, 4)))
+                    : life_set_topology(state.world, topology, static_cast<int64_t>(get_le(data + 6, 8)),
+                                        static_cast<int64_t>(get_le(data + 14, 8)));
+                if (!ok) connected = false;
+                ready = true;
+            } else if (data[0] == 'C') {
+                if (ready) life_xor_record(state.world, key, bits.data(), bits.size());
+            } else {
+                generation = static_cast<int64_t>(get_le(data + 1, 8));
+                population = static_cast<int64_t>(get_le(data + 9, 8));
+                frames++;
+                frame = true;
+            }
+            pos += length;
+        }
+        in.erase(0, pos);
+        
+        if (state.viewport_changed || state.need_full_refresh) {
+            clear();
+            draw_all_visible_chunks(state);
+            state.viewport_changed = false;
+            state.need_full_refresh = false;
+            life_clear_dirty(state.world);
+        } else if (frame) {
+            draw_dirty_chunks(state);
+        }
+        frame = false;
+        
+        mvprintw(0, 0, "WATCH %s - Gen: %lld, Cells: %lld | Frames: %lld | Received: %.1fMB | Viewport: (%lld, %lld)%s",
+                 address.c_str(), (long long)generation, (long long)population, (long long)frames,
+                 received / 1048576.0, (long long)state.viewport_x, (long long)state.viewport_y,
+                 connected ? "" : " [DISCONNECTED]");
+        clrtoeol();
+        refresh();
+        
+        int ch = getch();
+        if (ch == 'q' || ch == 'Q') break;
+        if (ch == 'w' || ch == 'W') state.viewport_y--;
+        else if (ch == 's' || ch == 'S') state.viewport_y++;
+        else if (ch == 'a' || ch == 'A') state.viewport_x--;
+        else if (ch == 'd' || ch == 'D') state.viewport_x++;
+        if (ch == 'w' || ch == 'W' || ch == 's' || ch == 'S' || ch == 'a' || ch == 'A' || ch == 'd' || ch == 'D') {
+            state.viewport_changed = true;
+            subscribe = true;
+        }
+        
+        // 每秒至多约30帧，其余的代在服务器端合并
+        this_thread::sleep_until(start_time + chrono::milliseconds(33));
+    }
+    close(fd);
+}
+
+// 无界面基准测试：测量块查找和演算速度
+int run_benchmark(int argc, char** argv) {
+    GameState state;
+    state.rows = 24;
+    state.cols = 80;
+    
+    int generations = 100;
+    string filename, serve_address;
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "-b") == 0) && i + 1 < argc) {
+            if (!set_topology(state, argv[i][1] == 't' ? LIFE_TORUS : LIFE_BOUNDED, argv[i+1])) {
+                fprintf(stderr, "Invalid size: %s\n", argv[i+1]);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            if (!set_chunk_size(state, atoi(argv[i+1]))) {
+                fprintf(stderr, "Invalid chunk size: %s\n", argv[i+1]);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            if (!life_set_rule(state.world, argv[i+1])) {
+                fprintf(stderr, "Invalid rule: %s\n", argv[i+1]);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            life_set_threads(state.world, max(1, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve_address = argv[++i];
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            if (i + 1 < argc && isdigit(argv[i+1][0])) generations = max(1, atoi(argv[++i]));
+            if (i + 1 < argc && argv[i+1][0] != '-') filename = argv[++i];
+        }
+    }
+    
+    // 无界面长时间运行时可以用 --watch 远程观看（流服务器在拓扑和块宽度确定之后启动）
+    if (!serve_address.empty()) {
+        state.server = make_unique<StreamServer>();
+        if (!state.server->start(serve_address, state.world)) {
+            fprintf(stderr, "Cannot listen on %s\n", serve_address.c_str());
+            return 1;
+        }
+        printf("Serving on %s\n", serve_address.c_str());
+    }
+    
+    // 随机汤使用固定种子，保证多次运行可比
+    const int64_t soup_size = 512;
+    if (!filename.empty()) {
+        if (load_world(state, filename) != SUCCESS) {
+            fprintf(stderr, "Error loading from %s\n", filename.c_str());
+            return 1;
+        }
+    } else {
+        mt19937_64 rng(12345);
+        for (int64_t y = 0; y < soup_size; y++) {
+            for (int64_t x = 0; x < soup_size; x++) {
+                if (rng() % 3 == 0) set_cell(state, x, y, true);
+            }
+        }
+    }
+    LifeStats stats;
+    life_stats(state.world, &stats);
+    printf("%s | Chunks: %zu | Cells: %lld\n", topology_label(state).c_str(),
+           stats.chunks, (long long)stats.population);
+    
+    // 块查找：在图案周围逐格调用 peek_cell（扫描范围与块几何无关，不同 -k 可直接比较）
+    const int64_t scan_min = -64;
+    const int64_t scan_max = soup_size + 64;
+    const int lookup_rounds = 40;
+    int64_t hits = 0;
+    auto start_time = chrono::steady_clock::now();
+    for (int r = 0; r < lookup_rounds; r++) {
+        for (int64_t y = scan_min; y < scan_max; y++) {
+            for (int64_t x = scan_min; x < scan_max; x++) {
+                hits += peek_cell(state, x, y);
+            }
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    double lookups = static_cast<double>(lookup_rounds) * (scan_max - scan_min) * (scan_max - scan_min);
+    printf("Lookup: %.1f M/s (%lld hits)\n", lookups / seconds / 1e6, (long long)hits);
+    
+    // 演算
+    life_clear_dirty(state.world);
+    start_time = chrono::steady_clock::now();
+    for (int i = 0; i < generations; i++) {
+        vector<ChunkRecord> delta;
+        compute_generation(state, stream_watching(state) ? &delta : nullptr);
+        state.generation++;
+        stream_publish(state, delta);
+        life_clear_dirty(state.world);
+    }
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    printf("Generations: %d in %.3fs | %.2f gen/s | Cells: %lld\n",
+           generations, seconds, generations / seconds, (long long)life_population(state.world));
+    return 0;
+}
+
+void setup_terminal() {
     cbreak();
     noecho();
     keypad(stdscr, TRUE);
@@ -860,12 +2336,9 @@ int main(int argc, char** argv) {
     set_escdelay(25);
     start_color();
     use_default_colors();
-    
-    srand(time(nullptr));
-    
-    GameState state;
-    init_game(state, argc, argv);
-    
+}
+
+void run_modes(GameState& state) {
     while (state.running) {
         switch (state.mode) {
             case DESIGN: design_mode(state); break;
@@ -873,6 +2346,97 @@ int main(int argc, char** argv) {
             case PLAY: play_mode(state); break;
         }
     }
+}
+
+// 无界面回放：界面输出到 /dev/null，按录制的按键全速重现会话，结束后输出各阶段耗时
+int run_replay(const string& filename) {
+    GameState state;
+    Session& session = state.session;
+    if (!load_session(filename, session)) {
+        fprintf(stderr, "Error loading session from %s\n", filename.c_str());
+        return 1;
+    }
+    session.replay = true;
+    
+    FILE* out = fopen("/dev/null", "w");
+    FILE* in = fopen("/dev/null", "r");
+    SCREEN* screen = (out && in) ? newterm("xterm", out, in) : nullptr;
+    if (!screen && out && in) screen = newterm("dumb", out, in);
+    if (!screen) {
+        fprintf(stderr, "Cannot open a headless terminal\n");
+        return 1;
+    }
+    resizeterm(session.rows, session.cols);
+    setup_terminal();
+    
+    vector<char*> argv = {const_cast<char*>("LifeGame")};
+    for (auto& arg : session.args) argv.push_back(const_cast<char*>(arg.c_str()));
+    init_game(state, static_cast<int>(argv.size()), argv.data());
+    
+    auto start = chrono::steady_clock::now();
+    run_modes(state);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    
+    endwin();
+    delscreen(screen);
+    fclose(out);
+    fclose(in);
+    
+    printf("Replay: %zu/%zu events | Generations: %lld in %.3fs\n", session.next, session.events.size(),
+           (long long)state.generation, seconds);
+    const char* names[PHASE_COUNT] = {"compute", "draw", "command", "fast-forward"};
+    printf("%-14s %10s %12s %12s\n", "Phase", "Count", "Total ms", "Avg us");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        int64_t count = state.phases.count[phase];
+        double total = state.phases.seconds[phase];
+        printf("%-14s %10lld %12.3f %12.3f\n", names[phase], (long long)count, total * 1e3,
+               count ? total * 1e6 / count : 0.0);
+    }
+    fflush(stdout);
+    if (session.diverged || session.next < session.events.size()) {
+        fprintf(stderr, "Replay diverged at event %zu\n", session.next);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    string watch_address;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            return run_benchmark(argc, argv);
+        }
+        if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc) {
+            watch_address = argv[i+1];
+        }
+        if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            return run_replay(argv[i+1]);
+        }
+    }
+    
+    // 远程观看：先连接，连不上时直接报错退出
+    int watch_fd = -1;
+    if (!watch_address.empty()) {
+        watch_fd = open_stream_socket(watch_address, false);
+        if (watch_fd < 0) {
+            fprintf(stderr, "Cannot connect to %s\n", watch_address.c_str());
+            return 1;
+        }
+    }
+    
+    initscr();
+    setup_terminal();
+    
+    srand(time(nullptr));
+    
+    GameState state;
+    if (watch_fd >= 0) {
+        watch_mode(state, watch_fd, watch_address);
+        endwin();
+        return 0;
+    }
+    init_game(state, argc, argv);
+    run_modes(state);
     
     endwin();
     return 0;
@@ -1,7 +1,15 @@
-// g++ -o SRF srf.cpp -lncurses -lutil
+// g++ -o SRF srf.cpp -lncurses -lutil -pthread
+// ./SRF --compile srf.conf   // 预编译词库映像 srf.dict（启动时 mmap，不比 srf.conf 旧时不再解析）
+// ./SRF --bench srf.conf nihaozhongguo   // 每次按键更新候选的延迟：从头计算与增量计算对比
+// ./SRF --stats bash   // 退出时报告输入法界面每次重画输出的字节数
 #include <curses.h>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <string_view>
+#include <cstdint>
 #include <fstream>
 #include <sstream>
 #include <cstring>
@@ -9,32 +17,310 @@
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
 #include <pty.h>
 #include <termios.h>
 #include <signal.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
 #include <sys/select.h>
-#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+// 拼音字典：紧凑的数组字典树，节点按层序存放，每个节点的子节点连续存放并按字母排序
+// 每个节点预先算好以它为前缀的所有拼音中排名最前的 TOP_K 个候选，输入半个音节时也能 O(长度) 取到候选
+const int TOP_K = 16;
+
+struct TrieNode {
+    uint32_t first_child;  // 第一个子节点的下标
+    uint32_t word_begin;   // 本节点（完整拼音）的候选在 words 中的范围
+    uint32_t word_count;
+    uint32_t top_begin;    // 前缀候选在 top 中的范围（已按排名排序）
+    uint8_t top_count;
+    uint8_t child_count;
+    char label;            // 从父节点到本节点的字母
+    uint8_t depth;
+};
+
+struct DictWord {
+    uint32_t text;    // 在字符串池中的偏移
+    uint16_t length;
+    uint16_t rank;    // 在 srf.conf 中所在行的位置，越小越常用
+    uint32_t hash;    // 词文本的哈希，用于查二元语法
+};
+
+// 二元语法：srf.conf 中的 @前词 后词 次数，按 (前词哈希 << 32 | 后词哈希) 排序
+struct Bigram {
+    uint64_t key;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+// 词文本的 FNV-1a 哈希
+uint32_t text_hash(std::string_view text) {
+    uint32_t h = 2166136261u;
+    for (unsigned char c : text) h = (h ^ c) * 16777619u;
+    return h;
+}
+
+// 字典映像（srf --compile 生成，与 .conf 同名、扩展名为 .dict）：文件头之后依次是 bigrams、nodes、words、top 和字符串池
+// 启动时只读 mmap 后直接使用，不做任何解析；映像比 .conf 旧或格式不符时重新编译
+struct DictHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t top_k;
+    uint32_t max_key;  // 最长的拼音
+    uint32_t fuzzy;    // 开启的模糊音（FUZZY_RULES 中的位）
+    uint64_t node_count;
+    uint64_t word_count;
+    uint64_t top_count;
+    uint64_t bigram_count;
+    uint64_t pool_size;
+};
+
+const char DICT_MAGIC[8] = {'S', 'R', 'F', 'D', 'I', 'C', 'T', 0};
+const uint32_t DICT_VERSION = 3;
+
+// 模糊音：srf.conf 中以 ~ 开头的行开启，如 ~z=zh、~an=ang
+// 声母 z/zh、c/ch、s/sh 为多或少一个 h，韵母 an/ang、en/eng、in/ing 为多或少一个 g（ian/iang、uan/uang 包含在 an/ang 中），其余为两个声母互换
+// 查找时在字典树上展开，不生成额外的拼音
+struct FuzzyRule {
+    const char* exact;
+    const char* fuzzy;
+};
+
+const FuzzyRule FUZZY_RULES[] = {
+    {"z", "zh"}, {"c", "ch"}, {"s", "sh"}, {"n", "l"}, {"f", "h"}, {"r", "l"}, {"an", "ang"}, {"en", "eng"}, {"in", "ing"},
+};
+
+struct Dictionary {
+    const TrieNode* nodes = nullptr;  // nodes[0] 为根
+    const DictWord* words = nullptr;
+    const uint32_t* top = nullptr;    // words 的下标
+    const Bigram* bigrams = nullptr;
+    const char* pool = nullptr;
+    size_t node_count = 0;
+    size_t word_count = 0;
+    size_t bigram_count = 0;
+    size_t max_key = 0;
+    uint32_t fuzzy = 0;
+    char fuzzy_swap[128][2] = {};     // 可以互换的声母
+    bool fuzzy_h[128] = {};           // 后面可多可少一个 h 的声母
+    bool fuzzy_g[128] = {};           // 在 n 后面可多可少一个 g 的元音
+    
+    void* mapped = nullptr;           // mmap 的映像文件
+    size_t mapped_size = 0;
+    std::string image;                // 写不出映像文件时，映像保存在内存中
+    
+    // 检查映像并指向其中各段：各段大小、子节点和候选的范围、词文本的位置都必须落在映像之内
+    // 过时、损坏或别处来的映像在这里被拒绝，由调用方重新编译
+    bool attach(const char* data, size_t size) {
+        DictHeader header;
+        if (size < sizeof(header)) return false;
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, DICT_MAGIC, sizeof(DICT_MAGIC)) != 0 ||
+            header.version != DICT_VERSION || header.top_k != TOP_K || header.node_count == 0) return false;
+        // 逐段扣除大小：先比较个数与剩余字节数，乘法和累加都不会溢出
+        uint64_t left = size - sizeof(header);
+        auto take = [&left](uint64_t count, size_t item) {
+            if (count > left / item) return false;
+            left -= count * item;
+            return true;
+        };
+        if (!take(header.bigram_count, sizeof(Bigram)) || !take(header.node_count, sizeof(TrieNode)) ||
+            !take(header.word_count, sizeof(DictWord)) || !take(header.top_count, sizeof(uint32_t)) ||
+            left != header.pool_size) return false;
+        // 下标都是 32 位，UINT32_MAX 留作 NO_WORD
+        if (header.node_count > UINT32_MAX || header.word_count >= UINT32_MAX || header.top_count > UINT32_MAX) return false;
+        
+        const char* p = data + sizeof(header);
+        const Bigram* image_bigrams = reinterpret_cast<const Bigram*>(p);
+        p += header.bigram_count * sizeof(Bigram);
+        const TrieNode* image_nodes = reinterpret_cast<const TrieNode*>(p);
+        p += header.node_count * sizeof(TrieNode);
+        const DictWord* image_words = reinterpret_cast<const DictWord*>(p);
+        p += header.word_count * sizeof(DictWord);
+        const uint32_t* image_top = reinterpret_cast<const uint32_t*>(p);
+        p += header.top_count * sizeof(uint32_t);
+        
+        // 节点按层序存放，子节点都在父节点之后，字典树上不会有环
+        for (uint64_t i = 0; i < header.node_count; i++) {
+            const TrieNode& n = image_nodes[i];
+            if (n.child_count && (n.first_child <= i || uint64_t(n.first_child) + n.child_count > header.node_count)) return false;
+            if (uint64_t(n.word_begin) + n.word_count > header.word_count) return false;
+            if (n.top_count > TOP_K || uint64_t(n.top_begin) + n.top_count > header.top_count) return false;
+        }
+        for (uint64_t i = 0; i < header.word_count; i++) {
+            if (uint64_t(image_words[i].text) + image_words[i].length > header.pool_size) return false;
+        }
+        for (uint64_t i = 0; i < header.top_count; i++) {
+            if (image_top[i] >= header.word_count) return false;
+        }
+        // 二元语法按键二分查找，必须有序
+        for (uint64_t i = 1; i < header.bigram_count; i++) {
+            if (image_bigrams[i - 1].key > image_bigrams[i].key) return false;
+        }
+        
+        bigrams = image_bigrams;
+        nodes = image_nodes;
+        words = image_words;
+        top = image_top;
+        pool = p;
+        node_count = header.node_count;
+        word_count = header.word_count;
+        bigram_count = header.bigram_count;
+        max_key = header.max_key;
+        set_fuzzy(header.fuzzy);
+        return true;
+    }
+    
+    void set_fuzzy(uint32_t rules) {
+        fuzzy = rules;
+        memset(fuzzy_swap, 0, sizeof(fuzzy_swap));
+        memset(fuzzy_h, 0, sizeof(fuzzy_h));
+        memset(fuzzy_g, 0, sizeof(fuzzy_g));
+        for (size_t i = 0; i < sizeof(FUZZY_RULES) / sizeof(FUZZY_RULES[0]); i++) {
+            if (!(rules >> i & 1)) continue;
+            const FuzzyRule& rule = FUZZY_RULES[i];
+            size_t length = strlen(rule.exact);
+            if (strlen(rule.fuzzy) == 1) {
+                int a = rule.exact[0], b = rule.fuzzy[0];
+                (fuzzy_swap[a][0] ? fuzzy_swap[a][1] : fuzzy_swap[a][0]) = b;
+                (fuzzy_swap[b][0] ? fuzzy_swap[b][1] : fuzzy_swap[b][0]) = a;
+            } else if (rule.fuzzy[length] == 'h') {
+                fuzzy_h[static_cast<int>(rule.exact[0])] = true;
+            } else {
+                fuzzy_g[static_cast<int>(rule.exact[0])] = true;
+            }
+        }
+    }
+    
+    // 前词之后出现后词的次数
+    uint32_t bigram(uint32_t prev, uint32_t word) const {
+        uint64_t key = static_cast<uint64_t>(words[prev].hash) << 32 | words[word].hash;
+        const Bigram* end = bigrams + bigram_count;
+        const Bigram* it = std::lower_bound(bigrams, end, key, [](const Bigram& b, uint64_t k) { return b.key < k; });
+        return it != end && it->key == key ? it->count : 0;
+    }
+    
+    // 从节点沿一个字母走到子节点，不存在时返回 -1
+    int child(uint32_t node, char c) const {
+        const TrieNode& parent = nodes[node];
+        uint32_t child = parent.first_child, end = parent.first_child + parent.child_count;
+        while (child < end && nodes[child].label < c) child++;
+        return child < end && nodes[child].label == c ? static_cast<int>(child) : -1;
+    }
+    
+    std::string_view text(uint32_t word) const {
+        return std::string_view(pool + words[word].text, words[word].length);
+    }
+};
+
+// 整句输入：输入的每个位置是格子图的一列，列中保留覆盖到该位置、代价最小的 BEAM 条路径（最后一个词各不相同，供二元语法使用）
+// 每列还保存字典树游标：input[i, j) 在字典树中走到的节点（各个起点 i 各一个），新的一列由上一列的游标各走一个字母得到
+// 追加字母只计算新的一列，退格只删掉最后一列，前面的列原样复用，每次按键的开销与输入长度无关
+const int BEAM = 8;
+const int EDGE_WORDS = 6;           // 每段拼音只取排名最前的几个词参与整句解码
+const int SENTENCES = 3;            // 整句候选数
+const size_t MAX_INPUT = 64;
+const float WORD_COST = 4.0f;       // 每个词的固定代价：词越少（词组越长）越好
+const float PARTIAL_COST = 2.0f;    // 末尾没打完的音节
+const float BIGRAM_WEIGHT = 1.5f;
+const uint32_t NO_WORD = UINT32_MAX;
+
+struct LatticeState {
+    float cost;
+    uint32_t word;   // 最后一个词（words 的下标），空路径为 NO_WORD
+    uint16_t from;   // 最后一个词的起点列
+    uint16_t back;   // 起点列中的前一状态
+};
+
+struct TrieCursor {
+    uint16_t start;  // 起点列
+    uint16_t fuzzy;  // 用到的模糊音处数
+    uint32_t node;   // input[start, j) 对应的节点
+};
+
+const int MAX_FUZZY = 2;          // 一个词中最多几处模糊音
+const size_t MAX_CURSORS = 48;    // 开启模糊音时每列最多保留的游标，多出的丢掉模糊音处最多的
+const float FUZZY_COST = 3.0f;    // 每处模糊音的代价
+
+struct Lattice {
+    std::string input;                               // 已建好列的输入
+    std::vector<std::vector<LatticeState>> columns;  // columns[j] 为覆盖 input[0, j) 的路径
+    std::vector<std::vector<TrieCursor>> cursors;    // cursors[j] 按起点从小到大排列
+};
+
+// 候选词：text 指向字典的字符串池或整句缓冲，consumed 为提交后从输入开头去掉的字母数
+struct Candidate {
+    std::string_view text;
+    size_t consumed;
+    uint32_t word;   // 词的下标；整句候选为 NO_WORD
+    int sentence;    // 整句候选的序号，单个词为 -1
+};
 
 // 输入法状态结构
 struct InputMethodState {
     bool is_chinese;            // 当前是否为中文模式
     std::string input_buffer;   // 输入的拼音字符串
-    std::vector<std::string> candidates; // 候选词列表
+    std::string display;        // 显示的拼音（按最优整句切分音节）
+    std::vector<Candidate> candidates; // 候选词列表
+    std::vector<std::string> sentences; // 整句候选的文本
+    std::vector<std::vector<uint32_t>> sentence_words; // 整句候选中的各个词
+    Lattice lattice;
     int selected_index;         // 当前选中的候选词索引
     int page_start;             // 当前页的起始索引
     int page_size;              // 每页显示的候选词数量
 };
 
+// 用户词频：每次上屏的词追加一条记录到与 .conf 同名、扩展名为 .user 的日志，启动时读入并合并成计数
+// 记录数多于不同词数的两倍时，后台线程把计数写成每个词一条的新日志，写完后主线程补上期间追加的记录再替换旧日志
+// 同时运行的几个实例共用日志：追加和替换都在 flock 锁内，每次追加前先读入别的实例追加的记录
+struct UserRecord {
+    uint32_t hash;   // 词文本的哈希（与 DictWord::hash 相同，重新编译字典后仍然有效）
+    uint32_t count;
+};
+
+const char USER_MAGIC[8] = {'S', 'R', 'F', 'U', 'S', 'E', 'R', 0};
+const float USER_WEIGHT = 2.0f;          // 用户次数在排名中的权重
+const size_t COMPACT_MIN_RECORDS = 4096;
+
+struct UserLog {
+    std::string path;
+    int fd = -1;                                    // 以追加方式打开，-1 为不记录
+    size_t records = 0;                             // 日志中的记录数
+    std::unordered_map<uint32_t, uint32_t> counts;  // 词文本哈希 -> 次数
+    std::vector<uint32_t> word_counts;              // 按 words 下标的次数，排名时直接查
+    std::thread compactor;
+    std::atomic<int> compact_result{0};             // 后台压缩：0 未完成，1 成功，-1 失败
+    bool compacting = false;
+    bool compact_failed = false;
+    size_t compact_records = 0;                     // 压缩后的日志中的记录数
+    off_t size = 0;                                 // 已读入 counts 的日志长度，别的实例追加的记录从这里读起
+    off_t compact_size = 0;                         // 开始压缩时的 size，此后追加的记录收尾时补到新日志
+    unsigned generation = 0;                        // 日志被别的实例替换、重新打开的次数
+    unsigned compact_generation = 0;
+};
+
 // 全局变量
-std::map<std::string, std::vector<std::string>> dictionary; // 拼音字典
+Dictionary dictionary;          // 拼音字典
+UserLog user_log;               // 用户词频
 InputMethodState im_state;
 int pty_master;                // 伪终端主设备
 int orig_lines, orig_cols;     // 原始终端尺寸
 struct termios orig_termios;   // 原始终端设置
-bool resize_occurred = false;  // 终端大小改变标志
 pid_t child_pid = -1;          // 子进程PID
-volatile sig_atomic_t child_exited = 0; // 子进程退出标志
+int child_status = -1;         // 子进程已回收时的退出状态
+sigset_t event_signals;        // 由 signalfd 接收的信号（SIGWINCH、SIGCHLD），平时屏蔽
+std::string child_queue;       // 等待写入子进程的数据（伪终端满时留在这里，等 EPOLLOUT 再写）
+size_t child_queue_sent = 0;   // 其中已写出的字节数
+const size_t CHILD_QUEUE_LIMIT = 1 << 20; // 积压超过这么多时暂停读取键盘输入
 
 // 颜色定义 - 使用ANSI颜色
 #define INPUT_COLOR "\033[38;5;15;48;5;21m"      // 白字蓝底
@@ -43,15 +329,41 @@ volatile sig_atomic_t child_exited = 0; // 子进程退出标志
 #define STATUS_COLOR "\033[38;5;11;48;5;21m"     // 黄字蓝底
 #define RESET_COLOR "\033[0m"                    // 重置颜色
 
-// 信号处理函数：处理终端大小改变
-void handle_sigwinch(int sig) {
-    resize_occurred = true;
-}
+// 输入法界面占终端最后两行：每次按单元格合成一帧，与屏幕上的上一帧比较，只输出变化的单元格，一次 write 写出
+// 多字节字符中三、四字节的（中文等）按占两格处理；子进程输出后屏幕可能被改动，下一帧整个重画
+enum CellColor : uint8_t { COLOR_NONE, COLOR_INPUT, COLOR_CANDIDATE, COLOR_SELECTED, COLOR_STATUS };
+const char* const CELL_COLORS[] = {RESET_COLOR, INPUT_COLOR, CANDIDATE_COLOR, SELECTED_COLOR, STATUS_COLOR};
+const int IME_ROWS = 2;
 
-// 信号处理函数：处理子进程退出
-void handle_sigchld(int sig) {
-    child_exited = 1;
-}
+struct Cell {
+    char glyph[4];   // UTF-8 字符，不足4字节补0
+    uint8_t width;   // 0 为宽字符的第二格
+    uint8_t color;
+    
+    bool operator==(const Cell& other) const { return memcmp(this, &other, sizeof(Cell)) == 0; }
+    bool operator!=(const Cell& other) const { return !(*this == other); }
+};
+
+const Cell BLANK_CELL = {{' ', 0, 0, 0}, 1, COLOR_NONE};
+
+struct ImeFrame {
+    int cols = 0;
+    std::vector<Cell> cells;   // IME_ROWS 行，每行 cols 格
+    bool valid = false;        // 屏幕上是否正是这一帧
+};
+
+// --stats：退出时报告每次重画输出的字节数，以及整帧重画需要的字节数
+struct DrawStats {
+    bool enabled = false;
+    size_t frames = 0;
+    size_t bytes = 0;
+    size_t max_bytes = 0;
+    size_t full_bytes = 0;
+};
+
+ImeFrame ime_frame, screen_frame;  // 正在合成的帧和屏幕上的帧
+std::string frame_output;          // 一帧的输出
+DrawStats draw_stats;
 
 // 恢复终端设置
 void restore_terminal() {
@@ -73,16 +385,44 @@ void cleanup_exit(int sig) {
     _exit(sig);
 }
 
-// 加载配置文件
-void load_config(const char* filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) return;
+// srf.conf 的内容
+struct Config {
+    std::map<std::string, std::vector<std::string>> entries;     // 拼音 -> 候选词
+    std::map<std::pair<std::string, std::string>, uint32_t> bigrams;  // (前词, 后词) -> 次数
+    uint32_t fuzzy = 0;                                               // 开启的模糊音
+};
 
+// 读取 srf.conf：每行为 拼音=候选词 候选词 ...，候选词按常用程度排列；拼音可以是多个音节连写的词组（如 beijing=北京）
+// 以 @ 开头的行为二元语法：@前词 后词 次数；以 ~ 开头的行开启一组模糊音：~z=zh（两边顺序不限）
+bool parse_config(const char* filename, Config& config) {
+    std::ifstream file(filename);
+    if (!file.is_open()) return false;
+    
+    std::map<std::string, std::vector<std::string>>& entries = config.entries;
     std::string line;
     while (std::getline(file, line)) {
         // 跳过空行和注释
         if (line.empty() || line[0] == '#') continue;
         
+        if (line[0] == '@') {
+            std::istringstream iss(line.substr(1));
+            std::string prev, word;
+            uint32_t count;
+            if (iss >> prev >> word >> count) config.bigrams[{prev, word}] += count;
+            continue;
+        }
+        
+        if (line[0] == '~') {
+            size_t pos = line.find('=');
+            if (pos == std::string::npos) continue;
+            std::string a = line.substr(1, pos - 1), b = line.substr(pos + 1);
+            for (size_t i = 0; i < sizeof(FUZZY_RULES) / sizeof(FUZZY_RULES[0]); i++) {
+                if ((a == FUZZY_RULES[i].exact && b == FUZZY_RULES[i].fuzzy) ||
+                    (b == FUZZY_RULES[i].exact && a == FUZZY_RULES[i].fuzzy)) config.fuzzy |= 1u << i;
+            }
+            continue;
+        }
+        
         size_t pos = line.find('=');
         if (pos == std::string::npos) continue;
         
@@ -97,102 +437,932 @@ void load_config(const char* filename) {
             candidate_list.push_back(word);
         }
         
-        dictionary[key] = candidate_list;
+        entries[key] = candidate_list;
     }
+    return true;
 }
 
-// 更新候选词列表
-void update_candidates() {
-    im_state.candidates.clear();
+// 由拼音 -> 候选词表建立字典树（键已排序），返回字典映像
+std::string compile_dictionary(const Config& config) {
+    const std::map<std::string, std::vector<std::string>>& entries = config.entries;
+    // 先建指针形式的树，再按层序展开为数组
+    struct BuildNode {
+        std::map<char, BuildNode*> children;
+        const std::vector<std::string>* words = nullptr;
+        ~BuildNode() { for (auto& child : children) delete child.second; }
+    };
+    BuildNode root;
+    for (auto& entry : entries) {
+        BuildNode* node = &root;
+        for (char c : entry.first) {
+            BuildNode*& child = node->children[c];
+            if (!child) child = new BuildNode();
+            node = child;
+        }
+        node->words = &entry.second;
+    }
+    
+    std::vector<TrieNode> nodes;
+    std::vector<DictWord> words;
+    std::vector<uint32_t> top;
+    std::string pool;
+    uint32_t max_key = 0;
+    std::vector<BuildNode*> order = {&root};
+    nodes.push_back({0, 0, 0, 0, 0, 0, 0, 0});
+    for (size_t i = 0; i < order.size(); i++) {
+        BuildNode* node = order[i];
+        TrieNode& flat = nodes[i];
+        flat.first_child = static_cast<uint32_t>(order.size());
+        flat.child_count = static_cast<uint8_t>(node->children.size());
+        flat.word_begin = static_cast<uint32_t>(words.size());
+        if (node->words) {
+            uint16_t rank = 0;
+            for (auto& word : *node->words) {
+                words.push_back({static_cast<uint32_t>(pool.size()), static_cast<uint16_t>(word.size()), rank, text_hash(word)});
+                pool += word;
+                if (rank < UINT16_MAX) rank++;
+            }
+        }
+        flat.word_count = static_cast<uint32_t>(words.size()) - flat.word_begin;
+        uint8_t depth = flat.depth;
+        max_key = std::max<uint32_t>(max_key, depth);
+        for (auto& child : node->children) {
+            order.push_back(child.second);
+            nodes.push_back({0, 0, 0, 0, 0, 0, child.first, static_cast<uint8_t>(std::min(depth + 1, 255))});
+        }
+    }
+    
+    // 自底向上合并前缀候选：本节点的候选和各子节点的前缀候选按（排名，拼音长度）取前 TOP_K 个
+    std::vector<std::vector<uint32_t>> best(nodes.size());
+    auto better = [&](uint32_t a, uint32_t b) {
+        if (words[a].rank != words[b].rank) return words[a].rank < words[b].rank;
+        return a < b;  // 同排名时按层序，短拼音在前
+    };
+    for (size_t i = nodes.size(); i-- > 1; ) {
+        TrieNode& node = nodes[i];
+        std::vector<uint32_t>& list = best[i];
+        for (uint32_t w = node.word_begin; w < node.word_begin + node.word_count && list.size() < TOP_K; w++) {
+            list.push_back(w);
+        }
+        for (uint32_t c = node.first_child; c < node.first_child + node.child_count; c++) {
+            std::vector<uint32_t> merged;
+            std::merge(list.begin(), list.end(), best[c].begin(), best[c].end(), std::back_inserter(merged), better);
+            if (merged.size() > TOP_K) merged.resize(TOP_K);
+            list.swap(merged);
+            std::vector<uint32_t>().swap(best[c]);
+        }
+        node.top_begin = static_cast<uint32_t>(top.size());
+        node.top_count = static_cast<uint8_t>(list.size());
+        top.insert(top.end(), list.begin(), list.end());
+    }
+    
+    std::vector<Bigram> bigrams;
+    for (auto& entry : config.bigrams) {
+        uint64_t key = static_cast<uint64_t>(text_hash(entry.first.first)) << 32 | text_hash(entry.first.second);
+        bigrams.push_back({key, entry.second, 0});
+    }
+    std::sort(bigrams.begin(), bigrams.end(), [](const Bigram& a, const Bigram& b) { return a.key < b.key; });
+    
+    DictHeader header;
+    memcpy(header.magic, DICT_MAGIC, sizeof(DICT_MAGIC));
+    header.version = DICT_VERSION;
+    header.top_k = TOP_K;
+    header.max_key = max_key;
+    header.fuzzy = config.fuzzy;
+    header.node_count = nodes.size();
+    header.word_count = words.size();
+    header.top_count = top.size();
+    header.bigram_count = bigrams.size();
+    header.pool_size = pool.size();
+    
+    std::string image;
+    image.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    image.append(reinterpret_cast<const char*>(bigrams.data()), bigrams.size() * sizeof(Bigram));
+    image.append(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(TrieNode));
+    image.append(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(DictWord));
+    image.append(reinterpret_cast<const char*>(top.data()), top.size() * sizeof(uint32_t));
+    image += pool;
+    return image;
+}
+
+// srf.conf -> srf.dict / srf.user
+std::string data_path(const std::string& config, const char* extension) {
+    size_t dot = config.rfind('.');
+    size_t slash = config.rfind('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return config + extension;
+    return config.substr(0, dot) + extension;
+}
+
+// 先写临时文件再改名，正在使用旧映像的进程不受影响
+bool write_dictionary(const std::string& path, const std::string& image) {
+    std::string temp = path + ".tmp";
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    size_t done = 0;
+    while (done < image.size()) {
+        ssize_t n = write(fd, image.data() + done, image.size() - done);
+        if (n <= 0) break;
+        done += n;
+    }
+    bool ok = done == image.size() && close(fd) == 0;
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// 只读映射字典映像
+bool map_dictionary(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    if (!dictionary.attach(static_cast<const char*>(data), st.st_size)) {
+        munmap(data, st.st_size);
+        return false;
+    }
+    dictionary.mapped = data;
+    dictionary.mapped_size = st.st_size;
+    return true;
+}
+
+// 加载拼音字典：映像不比 .conf 旧时直接映射，否则重新编译（写不出映像文件时在内存中使用）
+void load_dictionary(const char* config) {
+    std::string path = data_path(config, ".dict");
+    struct stat conf_st, dict_st;
+    bool has_conf = stat(config, &conf_st) == 0;
+    bool has_dict = stat(path.c_str(), &dict_st) == 0;
+    bool fresh = has_dict && (!has_conf || dict_st.st_mtim.tv_sec > conf_st.st_mtim.tv_sec ||
+                              (dict_st.st_mtim.tv_sec == conf_st.st_mtim.tv_sec &&
+                               dict_st.st_mtim.tv_nsec >= conf_st.st_mtim.tv_nsec));
+    if (fresh && map_dictionary(path)) return;
+    
+    Config entries;
+    if (!parse_config(config, entries)) return;
+    std::string image = compile_dictionary(entries);
+    if (write_dictionary(path, image) && map_dictionary(path)) return;
+    dictionary.image.swap(image);
+    dictionary.attach(dictionary.image.data(), dictionary.image.size());
+}
+
+// srf --compile [srf.conf]：预先编译字典映像
+int compile_command(const char* config) {
+    Config entries;
+    if (!parse_config(config, entries)) {
+        fprintf(stderr, "Cannot read %s\n", config);
+        return 1;
+    }
+    std::string image = compile_dictionary(entries);
+    std::string path = data_path(config, ".dict");
+    if (!write_dictionary(path, image)) {
+        fprintf(stderr, "Cannot write %s\n", path.c_str());
+        return 1;
+    }
+    const DictHeader* header = reinterpret_cast<const DictHeader*>(image.data());
+    printf("%s: %zu keys, %llu words, %llu nodes, %llu bigrams, %zu bytes\n", path.c_str(), entries.entries.size(),
+           (unsigned long long)header->word_count, (unsigned long long)header->node_count,
+           (unsigned long long)header->bigram_count, image.size());
+    return 0;
+}
+
+bool write_all(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+// 打开用户日志并加上排他锁（几个 srf 同时运行时共用一个日志，读写都在锁内）
+// 别的实例压缩后会把新日志改名过来，锁住的若已不是路径指向的文件就重新打开
+int open_user_log(const std::string& path) {
+    for (int tries = 0; tries < 8; tries++) {
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) return -1;
+        struct stat st, current;
+        if (flock(fd, LOCK_EX) == 0 && fstat(fd, &st) == 0 && stat(path.c_str(), &current) == 0 &&
+            st.st_dev == current.st_dev && st.st_ino == current.st_ino) return fd;
+        close(fd);
+    }
+    return -1;
+}
+
+// 在锁内读入日志中 user_log.size 之后的记录（启动时是全部，之后是别的实例追加的），读到的词哈希放进 changed
+// 空文件先写入文件头；末尾不完整的记录（写到一半退出）截掉；不是用户日志或读写出错时返回 false
+bool read_user_log(std::vector<uint32_t>& changed) {
+    int fd = user_log.fd;
+    struct stat st;
+    if (fstat(fd, &st) != 0) return false;
+    if (user_log.size == 0) {
+        if (st.st_size == 0) {
+            if (!write_all(fd, USER_MAGIC, sizeof(USER_MAGIC))) return false;
+            user_log.size = sizeof(USER_MAGIC);
+            return true;
+        }
+        char magic[sizeof(USER_MAGIC)];
+        // 不是用户日志，不碰它
+        if (pread(fd, magic, sizeof(magic), 0) != sizeof(magic) || memcmp(magic, USER_MAGIC, sizeof(magic)) != 0) return false;
+        user_log.size = sizeof(magic);
+    }
+    if (st.st_size <= user_log.size) return true;
+    std::vector<UserRecord> records((st.st_size - user_log.size) / sizeof(UserRecord));
+    ssize_t n = pread(fd, records.data(), records.size() * sizeof(UserRecord), user_log.size);
+    if (n < 0) return false;
+    size_t count = n / sizeof(UserRecord);
+    for (size_t i = 0; i < count; i++) {
+        user_log.counts[records[i].hash] += records[i].count;
+        changed.push_back(records[i].hash);
+    }
+    user_log.records += count;
+    user_log.size += count * sizeof(UserRecord);
+    // 截不掉时不再追加，免得新记录接在半条记录后面错位；已读入的记录照常使用
+    return st.st_size == user_log.size || ftruncate(fd, user_log.size) == 0;
+}
+
+// 把 hashes 中各词的次数更新到 word_counts
+void update_word_counts(const std::vector<uint32_t>& hashes) {
+    if (hashes.empty()) return;
+    // 先查位图，绝大多数没选过的词不用查哈希表
+    std::vector<uint64_t> filter(1 << 14);
+    for (uint32_t hash : hashes) filter[(hash >> 6) & (filter.size() - 1)] |= 1ull << (hash & 63);
+    for (size_t w = 0; w < dictionary.word_count; w++) {
+        uint32_t hash = dictionary.words[w].hash;
+        if (!(filter[(hash >> 6) & (filter.size() - 1)] >> (hash & 63) & 1)) continue;
+        auto it = user_log.counts.find(hash);
+        if (it != user_log.counts.end()) user_log.word_counts[w] = it->second;
+    }
+}
+
+// 锁住用户日志并读入别的实例追加的记录；日志已被别的实例压缩替换时从头读入新日志
+// （新日志中已合并了旧日志的全部记录，包括本实例的）。出错时不再记录，返回 false
+bool lock_user_log() {
+    if (user_log.fd < 0) return false;
+    std::vector<uint32_t> changed;
+    struct stat st, current;
+    bool ok = flock(user_log.fd, LOCK_EX) == 0;
+    if (ok && (fstat(user_log.fd, &st) != 0 || stat(user_log.path.c_str(), &current) != 0 ||
+               st.st_dev != current.st_dev || st.st_ino != current.st_ino)) {
+        close(user_log.fd);
+        user_log.fd = open_user_log(user_log.path);
+        user_log.generation++;
+        user_log.size = 0;
+        user_log.records = 0;
+        user_log.counts.clear();
+        std::fill(user_log.word_counts.begin(), user_log.word_counts.end(), 0);
+        ok = user_log.fd >= 0;
+    }
+    ok = ok && read_user_log(changed);
+    update_word_counts(changed);
+    if (!ok && user_log.fd >= 0) {
+        close(user_log.fd);
+        user_log.fd = -1;
+    }
+    return ok;
+}
+
+void unlock_user_log() {
+    if (user_log.fd >= 0) flock(user_log.fd, LOCK_UN);
+}
+
+// 读入用户日志并合并成计数
+void load_user_log(const char* config) {
+    user_log.path = data_path(config, ".user");
+    user_log.word_counts.assign(dictionary.word_count, 0);
+    user_log.fd = open_user_log(user_log.path);
+    if (user_log.fd < 0) return;
+    std::vector<uint32_t> changed;
+    bool ok = read_user_log(changed);
+    update_word_counts(changed);
+    if (!ok) {
+        close(user_log.fd);
+        user_log.fd = -1;
+        return;
+    }
+    unlock_user_log();
+}
+
+// 后台压缩完成后由主线程收尾：在锁内把开始压缩后日志中追加的记录（本实例和别的实例的）补到新日志，替换旧日志
+// 日志太长时开始新的压缩；wait 为真时等后台压缩写完再收尾（退出前）
+void compact_user_log(bool wait = false) {
+    std::string temp = user_log.path + ".tmp." + std::to_string(getpid());
+    if (user_log.compacting) {
+        if (!wait && user_log.compact_result == 0) return;
+        user_log.compactor.join();
+        user_log.compacting = false;
+        if (user_log.compact_result < 0 || !lock_user_log()) {
+            unlink(temp.c_str());
+            user_log.compact_failed = user_log.compact_result < 0;
+            return;
+        }
+        if (user_log.generation != user_log.compact_generation) {
+            // 别的实例已经压缩过并替换了日志，这份快照作废
+            unlink(temp.c_str());
+            unlock_user_log();
+            return;
+        }
+        std::vector<UserRecord> tail((user_log.size - user_log.compact_size) / sizeof(UserRecord));
+        size_t bytes = tail.size() * sizeof(UserRecord);
+        int fd = open(temp.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+        bool ok = fd >= 0 && flock(fd, LOCK_EX) == 0 &&
+                  pread(user_log.fd, tail.data(), bytes, user_log.compact_size) == static_cast<ssize_t>(bytes) &&
+                  write_all(fd, tail.data(), bytes) && rename(temp.c_str(), user_log.path.c_str()) == 0;
+        if (!ok) {
+            if (fd >= 0) close(fd);
+            unlink(temp.c_str());
+            user_log.compact_failed = true;
+            unlock_user_log();
+            return;
+        }
+        // 新日志改名前已经锁住，等在旧日志锁上的实例拿到锁后会发现日志已替换，重新打开新日志
+        close(user_log.fd);
+        user_log.fd = fd;
+        user_log.records = user_log.compact_records + tail.size();
+        user_log.size = sizeof(USER_MAGIC) + user_log.records * sizeof(UserRecord);
+        unlock_user_log();
+        return;
+    }
+    if (user_log.fd < 0 || user_log.compact_failed || user_log.records < COMPACT_MIN_RECORDS ||
+        user_log.records < user_log.counts.size() * 2) return;
     
-    auto it = dictionary.find(im_state.input_buffer);
-    if (it != dictionary.end()) {
-        im_state.candidates = it->second;
+    // counts 恰好是日志前 size 字节中记录的合计
+    std::vector<UserRecord> snapshot;
+    snapshot.reserve(user_log.counts.size());
+    for (auto& [hash, count] : user_log.counts) snapshot.push_back({hash, count});
+    user_log.compacting = true;
+    user_log.compact_result = 0;
+    user_log.compact_records = snapshot.size();
+    user_log.compact_size = user_log.size;
+    user_log.compact_generation = user_log.generation;
+    user_log.compactor = std::thread([snapshot = std::move(snapshot), temp]() {
+        int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        bool ok = fd >= 0 && write_all(fd, USER_MAGIC, sizeof(USER_MAGIC)) &&
+                  write_all(fd, snapshot.data(), snapshot.size() * sizeof(UserRecord)) && fsync(fd) == 0;
+        if (fd >= 0) ok = close(fd) == 0 && ok;
+        user_log.compact_result = ok ? 1 : -1;
+    });
+}
+
+// 记下一次上屏的词
+void learn_word(uint32_t word) {
+    if (word == NO_WORD || !lock_user_log()) return;
+    UserRecord record = {dictionary.words[word].hash, 1};
+    if (!write_all(user_log.fd, &record, sizeof(record))) {
+        // 写了半条时截回去，免得后面的记录错位
+        if (ftruncate(user_log.fd, user_log.size) != 0) {
+            close(user_log.fd);
+            user_log.fd = -1;
+        }
+        unlock_user_log();
+        return;
+    }
+    user_log.size += sizeof(record);
+    user_log.records++;
+    user_log.counts[record.hash]++;
+    user_log.word_counts[word]++;
+    unlock_user_log();
+    compact_user_log();
+}
+
+// 退出前等待后台压缩结束并收尾
+void close_user_log() {
+    if (user_log.compacting) compact_user_log(true);
+    if (user_log.fd >= 0) close(user_log.fd);
+    user_log.fd = -1;
+}
+
+// 词的排名得分（越小越靠前）：静态排名减去用户选过的次数
+float word_score(uint32_t word) {
+    float score = std::log1p(static_cast<float>(dictionary.words[word].rank));
+    if (!user_log.word_counts.empty() && user_log.word_counts[word]) {
+        score -= USER_WEIGHT * std::log1p(static_cast<float>(user_log.word_counts[word]));
+    }
+    return score;
+}
+
+using ScoredWord = std::pair<float, uint32_t>;  // (得分, 词)
+
+// 按得分取一组词的前 limit 个：这组词已按静态排名排好，只需把用户选过的几个词取出来排序，再与其余的词归并
+// word_at(i) 为第 i 个词的下标；learned 为调用者提供的缓冲，每个选过的词只算一次得分
+template <typename WordAt>
+void ranked_words(size_t count, WordAt word_at, size_t limit, std::vector<ScoredWord>& learned, std::vector<uint32_t>& out) {
+    out.clear();
+    learned.clear();
+    const std::vector<uint32_t>& counts = user_log.word_counts;
+    if (!counts.empty()) {
+        for (size_t i = 0; i < count; i++) {
+            uint32_t w = word_at(i);
+            if (counts[w]) learned.push_back({word_score(w), w});
+        }
+    }
+    std::sort(learned.begin(), learned.end());
+    size_t i = 0, k = 0;
+    while (out.size() < limit && (i < count || k < learned.size())) {
+        if (i < count && !learned.empty() && counts[word_at(i)]) {
+            i++;
+            continue;
+        }
+        if (k < learned.size() && (i == count || learned[k].first <= word_score(word_at(i)))) out.push_back(learned[k++].second);
+        else out.push_back(word_at(i++));
+    }
+}
+
+// 词的代价：固定代价加上排名得分，再减去与前词的二元语法加分
+float word_cost(uint32_t prev, uint32_t word) {
+    float cost = WORD_COST + word_score(word);
+    if (prev != NO_WORD && dictionary.bigram_count) {
+        uint32_t count = dictionary.bigram(prev, word);
+        if (count) cost -= BIGRAM_WEIGHT * std::log1p(static_cast<float>(count));
+    }
+    return cost;
+}
+
+// 把以 from 列为起点、以 word 结尾的各条路径加入 out
+void extend_paths(const std::vector<LatticeState>& start, uint16_t from, uint32_t word, float extra,
+                  std::vector<LatticeState>& out) {
+    for (size_t k = 0; k < start.size(); k++) {
+        out.push_back({start[k].cost + extra + word_cost(start[k].word, word), word, from, static_cast<uint16_t>(k)});
+    }
+}
+
+// 按代价排序，同一个最后一词只留代价最小的一条，保留前 limit 条
+void prune_paths(std::vector<LatticeState>& paths, size_t limit) {
+    std::sort(paths.begin(), paths.end(), [](const LatticeState& a, const LatticeState& b) { return a.cost < b.cost; });
+    size_t kept = 0;
+    for (size_t i = 0; i < paths.size() && kept < limit; i++) {
+        bool seen = false;
+        for (size_t k = 0; k < kept && !seen; k++) seen = paths[k].word == paths[i].word;
+        if (!seen) paths[kept++] = paths[i];
+    }
+    paths.resize(kept);
+}
+
+// 游标走输入的第 j 个字母：精确匹配，以及开启的模糊音（声母互换、输入多出或缺少 h / g），每处模糊音 fuzzy 加一
+void advance_cursor(const std::string& input, size_t j, TrieCursor cursor, std::vector<TrieCursor>& out) {
+    unsigned char c = input[j - 1];
+    size_t first = out.size();
+    int node = dictionary.child(cursor.node, c);
+    if (node >= 0) out.push_back({cursor.start, cursor.fuzzy, static_cast<uint32_t>(node)});
+    if (!dictionary.fuzzy || cursor.fuzzy >= MAX_FUZZY || c >= 128) return;
+    
+    uint16_t fuzzy = cursor.fuzzy + 1;
+    for (char other : dictionary.fuzzy_swap[c]) {
+        if (other && (node = dictionary.child(cursor.node, other)) >= 0) {
+            out.push_back({cursor.start, fuzzy, static_cast<uint32_t>(node)});
+        }
+    }
+    // 输入多出的 h（zhi -> zi）和 g（ang -> an）：游标不动
+    unsigned char label = dictionary.nodes[cursor.node].label;
+    if (cursor.node != 0 && label < 128 &&
+        ((c == 'h' && dictionary.fuzzy_h[label]) ||
+         (c == 'g' && label == 'n' && j >= cursor.start + 3u && dictionary.fuzzy_g[input[j - 3] & 127]))) {
+        out.push_back({cursor.start, fuzzy, cursor.node});
+    }
+    // 输入缺少的 h（zi -> zhi）和 g（an -> ang）：再走一步到对应的子节点
+    size_t end = out.size();
+    for (size_t k = first; k < end; k++) {
+        if (out[k].fuzzy >= MAX_FUZZY || out[k].node == cursor.node) continue;
+        unsigned char next = dictionary.nodes[out[k].node].label;
+        char extra = 0;
+        if (next < 128 && dictionary.fuzzy_h[next]) extra = 'h';
+        else if (next == 'n' && j >= cursor.start + 2u && dictionary.fuzzy_g[input[j - 2] & 127]) extra = 'g';
+        if (extra && (node = dictionary.child(out[k].node, extra)) >= 0) {
+            out.push_back({cursor.start, static_cast<uint16_t>(out[k].fuzzy + 1), static_cast<uint32_t>(node)});
+        }
+    }
+}
+
+// 同一起点走到同一节点的游标只留模糊音最少的一个，超过 MAX_CURSORS 个时丢掉模糊音最多的；结果按（起点，模糊音处数）排序
+void prune_cursors(std::vector<TrieCursor>& cursors) {
+    std::sort(cursors.begin(), cursors.end(), [](const TrieCursor& a, const TrieCursor& b) {
+        if (a.start != b.start) return a.start < b.start;
+        if (a.node != b.node) return a.node < b.node;
+        return a.fuzzy < b.fuzzy;
+    });
+    cursors.erase(std::unique(cursors.begin(), cursors.end(), [](const TrieCursor& a, const TrieCursor& b) {
+        return a.start == b.start && a.node == b.node;
+    }), cursors.end());
+    if (cursors.size() > MAX_CURSORS) {
+        std::stable_sort(cursors.begin(), cursors.end(), [](const TrieCursor& a, const TrieCursor& b) { return a.fuzzy < b.fuzzy; });
+        cursors.resize(MAX_CURSORS);
+    }
+    std::sort(cursors.begin(), cursors.end(), [](const TrieCursor& a, const TrieCursor& b) {
+        if (a.start != b.start) return a.start < b.start;
+        if (a.fuzzy != b.fuzzy) return a.fuzzy < b.fuzzy;
+        return a.node < b.node;
+    });
+}
+
+// 计算第 j 列：上一列的游标各走一个字母，再从第 j - 1 列起一个新游标；以 input[i, j) 为一个词接在第 i 列的各条路径之后
+void compute_column(Lattice& lattice, size_t j) {
+    char c = lattice.input[j - 1];
+    std::vector<LatticeState>& column = lattice.columns[j];
+    std::vector<TrieCursor>& cursors = lattice.cursors[j];
+    column.clear();
+    cursors.clear();
+    if (c == '\'') {
+        // 音节分隔符：路径原样延续，词不能跨过它
+        column = lattice.columns[j - 1];
+        return;
     }
     
+    for (const TrieCursor& cursor : lattice.cursors[j - 1]) advance_cursor(lattice.input, j, cursor, cursors);
+    advance_cursor(lattice.input, j, {static_cast<uint16_t>(j - 1), 0, 0}, cursors);
+    if (dictionary.fuzzy) prune_cursors(cursors);
+    
+    std::vector<uint32_t> ranked;
+    std::vector<ScoredWord> learned;
+    for (const TrieCursor& cursor : cursors) {
+        if (lattice.columns[cursor.start].empty()) continue;
+        const TrieNode& n = dictionary.nodes[cursor.node];
+        ranked_words(n.word_count, [&](size_t i) { return n.word_begin + static_cast<uint32_t>(i); }, EDGE_WORDS, learned, ranked);
+        for (uint32_t w : ranked) extend_paths(lattice.columns[cursor.start], cursor.start, w, FUZZY_COST * cursor.fuzzy, column);
+    }
+    prune_paths(column, BEAM);
+}
+
+// 让格子图与输入一致：保留共同前缀对应的列，只计算之后的列
+void sync_lattice(Lattice& lattice, const std::string& input) {
+    size_t common = 0;
+    while (common < input.size() && common < lattice.input.size() && input[common] == lattice.input[common]) common++;
+    lattice.input = input;
+    if (lattice.columns.empty()) lattice.columns.push_back({{0, NO_WORD, 0, 0}});
+    lattice.columns.resize(common + 1);
+    lattice.columns.resize(input.size() + 1);
+    lattice.cursors.resize(common + 1);
+    lattice.cursors.resize(input.size() + 1);
+    for (size_t j = common + 1; j <= input.size(); j++) compute_column(lattice, j);
+}
+
+// 整句的最后一步：第 n 列的路径，以及末尾没打完的音节接在前面各列之后的路径（from 为起点列）
+void final_paths(const Lattice& lattice, std::vector<LatticeState>& paths) {
+    size_t n = lattice.input.size();
+    paths = lattice.columns[n];
+    std::vector<uint32_t> ranked;
+    std::vector<ScoredWord> learned;
+    for (const TrieCursor& cursor : lattice.cursors[n]) {
+        if (lattice.columns[cursor.start].empty()) continue;
+        const TrieNode& t = dictionary.nodes[cursor.node];
+        ranked_words(t.top_count, [&](size_t i) { return dictionary.top[t.top_begin + i]; }, EDGE_WORDS, learned, ranked);
+        for (uint32_t w : ranked) {
+            extend_paths(lattice.columns[cursor.start], cursor.start, w, PARTIAL_COST + FUZZY_COST * cursor.fuzzy, paths);
+        }
+    }
+    prune_paths(paths, BEAM);
+}
+
+// 沿回溯指针取出路径上的词（按顺序）
+void path_words(const Lattice& lattice, LatticeState state, std::vector<LatticeState>& words) {
+    words.clear();
+    while (state.word != NO_WORD) {
+        words.push_back(state);
+        state = lattice.columns[state.from][state.back];
+    }
+    std::reverse(words.begin(), words.end());
+}
+
+// 整句有没有依据：用到多于一个字的词（多音节的词条），或者相邻两词有二元语法
+// 词库中只有单字、没有二元语法时，整句只是逐段取最常用的字拼起来，不能排在单个词前面
+bool sentence_supported(const std::vector<LatticeState>& words) {
+    for (size_t k = 0; k < words.size(); k++) {
+        std::string_view text = dictionary.text(words[k].word);
+        size_t characters = 0;
+        for (unsigned char c : text) characters += (c & 0xC0) != 0x80;
+        if (characters > 1) return true;
+        if (k && dictionary.bigram_count && dictionary.bigram(words[k - 1].word, words[k].word)) return true;
+    }
+    return false;
+}
+
+// 更新候选词列表：整句候选（多于一个词、有依据且比单个词好时）在前；之后是输入开头的各段拼音的词，长的在前
+// 整个输入正好是一个拼音时，先给出它的候选，再给出以输入为前缀的其他拼音中排名最前的候选；各组内按用户词频重排
+void update_candidates() {
+    im_state.candidates.clear();
     im_state.selected_index = 0;
     im_state.page_start = 0;
+    const std::string& input = im_state.input_buffer;
+    im_state.display = input;
+    if (input.empty() || dictionary.node_count == 0) return;
+    
+    Lattice& lattice = im_state.lattice;
+    sync_lattice(lattice, input);
+    
+    std::vector<LatticeState> paths, words;
+    std::vector<uint32_t> ranked;
+    std::vector<ScoredWord> learned;
+    final_paths(lattice, paths);
+    size_t sentences = 0;
+    for (size_t p = 0; p < paths.size() && sentences < SENTENCES; p++) {
+        path_words(lattice, paths[p], words);
+        if (p == 0) {
+            // 按最优路径切分显示的拼音
+            im_state.display.clear();
+            for (size_t k = 0; k < words.size(); k++) {
+                if (k) im_state.display += '\'';
+                size_t end = k + 1 < words.size() ? words[k + 1].from : input.size();
+                for (size_t i = words[k].from; i < end; i++) {
+                    if (input[i] != '\'') im_state.display += input[i];
+                }
+            }
+        }
+        // 单个词的路径更好时，后面的整句都不如直接给出的词
+        if (words.size() < 2) break;
+        if (!sentence_supported(words)) continue;
+        std::string& text = im_state.sentences[sentences];
+        text.clear();
+        for (auto& word : words) text += dictionary.text(word.word);
+        bool duplicate = false;
+        for (size_t k = 0; k < sentences && !duplicate; k++) duplicate = im_state.sentences[k] == text;
+        if (duplicate) continue;
+        im_state.sentence_words[sentences].clear();
+        for (auto& word : words) im_state.sentence_words[sentences].push_back(word.word);
+        im_state.candidates.push_back({text, input.size(), NO_WORD, static_cast<int>(sentences)});
+        sentences++;
+    }
+    
+    // 输入开头各段拼音的节点就是各列中起点为0的游标（排在最前，精确匹配在模糊音之前），最后一列的即整个输入
+    // 模糊音的节点可能给出已经列出的词，开启模糊音时去重
+    std::unordered_set<uint32_t> seen;
+    auto add_word = [&](uint32_t w, size_t consumed) {
+        if (!dictionary.fuzzy || seen.insert(w).second) im_state.candidates.push_back({dictionary.text(w), consumed, w, -1});
+    };
+    size_t prefix = 0;
+    while (prefix < input.size() && !lattice.cursors[prefix + 1].empty() && lattice.cursors[prefix + 1][0].start == 0) prefix++;
+    if (prefix == input.size()) {
+        const std::vector<TrieCursor>& column = lattice.cursors[prefix];
+        for (size_t c = 0; c < column.size() && column[c].start == 0; c++) {
+            const TrieNode& t = dictionary.nodes[column[c].node];
+            ranked_words(t.word_count, [&](size_t i) { return t.word_begin + static_cast<uint32_t>(i); }, t.word_count, learned, ranked);
+            for (uint32_t w : ranked) {
+                bool duplicate = false;
+                for (size_t k = 0; k < sentences && !duplicate; k++) duplicate = im_state.sentences[k] == dictionary.text(w);
+                if (!duplicate) add_word(w, input.size());
+            }
+            ranked_words(t.top_count, [&](size_t i) { return dictionary.top[t.top_begin + i]; }, t.top_count, learned, ranked);
+            for (uint32_t w : ranked) {
+                if (w < t.word_begin || w >= t.word_begin + t.word_count) add_word(w, input.size());
+            }
+        }
+    }
+    for (size_t k = std::min(prefix, input.size() - 1); k > 0; k--) {
+        const std::vector<TrieCursor>& column = lattice.cursors[k];
+        for (size_t c = 0; c < column.size() && column[c].start == 0; c++) {
+            const TrieNode& t = dictionary.nodes[column[c].node];
+            ranked_words(t.word_count, [&](size_t i) { return t.word_begin + static_cast<uint32_t>(i); }, t.word_count, learned, ranked);
+            for (uint32_t w : ranked) add_word(w, k);
+        }
+    }
+}
+
+// 逐个字母输入再逐个退格，返回每次按键更新候选的耗时（微秒）；full 为真时每次都丢掉格子图从头计算
+std::vector<double> bench_keys(const std::string& text, bool full) {
+    std::vector<double> times;
+    std::string& input = im_state.input_buffer;
+    input.clear();
+    for (size_t i = 0; i < text.size() * 2; i++) {
+        if (i < text.size()) input.push_back(text[i]);
+        else input.pop_back();
+        if (full) im_state.lattice.input.clear();
+        auto start = std::chrono::steady_clock::now();
+        update_candidates();
+        times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    return times;
+}
+
+// --bench：比较每次按键从头计算和增量计算的延迟
+int bench_command(const char* config, int count, char* inputs[]) {
+    const int ROUNDS = 200;
+    load_dictionary(config);
+    if (dictionary.node_count == 0) {
+        fprintf(stderr, "%s: empty dictionary\n", config);
+        return 1;
+    }
+    std::vector<std::string> texts(inputs, inputs + count);
+    if (texts.empty()) texts = {"nihao", "woaibeijingtiananmen", "zhonghuarenmingongheguo", "jintiantianqizhenbucuowomenqugongyuanba"};
+    im_state.sentences.resize(SENTENCES);
+    im_state.sentence_words.resize(SENTENCES);
+    
+    printf("%-40s %5s %22s %22s\n", "input", "keys", "full avg/worst us", "incremental avg/worst us");
+    double totals[2] = {0, 0}, worst[2] = {0, 0};
+    size_t keys = 0;
+    for (const std::string& text : texts) {
+        std::string input = text.substr(0, MAX_INPUT);
+        double sum[2] = {0, 0}, max[2] = {0, 0};
+        for (int round = 0; round < ROUNDS; round++) {
+            for (int mode = 0; mode < 2; mode++) {
+                for (double t : bench_keys(input, mode == 0)) {
+                    sum[mode] += t;
+                    max[mode] = std::max(max[mode], t);
+                }
+            }
+        }
+        size_t n = input.size() * 2 * ROUNDS;
+        printf("%-40s %5zu %12.2f / %7.2f %12.2f / %7.2f\n", input.c_str(), input.size() * 2,
+               sum[0] / n, max[0], sum[1] / n, max[1]);
+        for (int mode = 0; mode < 2; mode++) {
+            totals[mode] += sum[mode];
+            worst[mode] = std::max(worst[mode], max[mode]);
+        }
+        keys += n;
+    }
+    printf("%-40s %5zu %12.2f / %7.2f %12.2f / %7.2f\n", "total", keys, totals[0] / keys, worst[0], totals[1] / keys, worst[1]);
+    return 0;
 }
 
 // 发送字符串到子进程
-void send_to_child(const std::string& str) {
+// 只放入队列，由 flush_child_queue 一次写出
+void send_to_child(std::string_view str) {
     if (pty_master != -1) {
-        write(pty_master, str.c_str(), str.size());
+        child_queue.append(str.data(), str.size());
+    }
+}
+
+// 把队列尽量写入伪终端，写不下的留到下次 EPOLLOUT
+void flush_child_queue() {
+    while (child_queue_sent < child_queue.size()) {
+        ssize_t n = write(pty_master, child_queue.data() + child_queue_sent, child_queue.size() - child_queue_sent);
+        if (n > 0) {
+            child_queue_sent += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (n < 0 && errno != EAGAIN) child_queue_sent = child_queue.size();  // 子进程已经不在了
+            break;
+        }
+    }
+    if (child_queue_sent == child_queue.size()) {
+        child_queue.clear();
+        child_queue_sent = 0;
+    } else if (child_queue_sent > child_queue.size() / 2) {
+        child_queue.erase(0, child_queue_sent);
+        child_queue_sent = 0;
     }
 }
 
 // 绘制输入法界面
-void draw_ime() {
-    // 保存光标位置
-    printf("\0337"); // DECSC - 保存光标位置
-    
-    // 定位到倒数第二行并清除
-    printf("\033[%d;1H\033[K", orig_lines - 1);
-    printf(INPUT_COLOR "输入: %s", im_state.input_buffer.c_str());
-    
-    // 填充剩余空间
-    int used = 8 + im_state.input_buffer.size();
-    for (int i = used; i < orig_cols - 10; i++) {
-        putchar(' ');
+void draw_ime();
+
+// 提交候选词：从输入开头去掉它对应的拼音，还有剩余时继续显示剩余部分的候选
+void commit_candidate(int index) {
+    const Candidate& candidate = im_state.candidates[index];
+    send_to_child(candidate.text);
+    if (candidate.sentence >= 0) {
+        for (uint32_t word : im_state.sentence_words[candidate.sentence]) learn_word(word);
+    } else {
+        learn_word(candidate.word);
     }
+    std::string& input = im_state.input_buffer;
+    size_t consumed = candidate.consumed;
+    while (consumed < input.size() && input[consumed] == '\'') consumed++;
+    input.erase(0, consumed);
+    update_candidates();
+    draw_ime();
+}
+
+// 从第 col 格起写入文字，返回写完后的列；超出行宽的部分截掉
+int put_text(ImeFrame& frame, int row, int col, std::string_view text, uint8_t color) {
+    Cell* line = &frame.cells[row * frame.cols];
+    for (size_t i = 0; i < text.size(); ) {
+        unsigned char c = text[i];
+        size_t length = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        int width = length >= 3 ? 2 : 1;
+        if (i + length > text.size() || col + width > frame.cols) break;
+        Cell& cell = line[col];
+        memset(cell.glyph, 0, sizeof(cell.glyph));
+        memcpy(cell.glyph, text.data() + i, length);
+        cell.width = width;
+        cell.color = color;
+        if (width == 2) line[col + 1] = {{0, 0, 0, 0}, 0, color};
+        col += width;
+        i += length;
+    }
+    return col;
+}
+
+// 合成输入法界面：第一行为输入的拼音和中英文状态，第二行为当前页的候选词
+void compose_ime(ImeFrame& frame) {
+    frame.cols = std::max(orig_cols, 0);
+    frame.cells.assign(IME_ROWS * frame.cols, BLANK_CELL);
     
-    // 显示中英文状态
-    printf(STATUS_COLOR "[%s]" RESET_COLOR, im_state.is_chinese ? "中文" : "英文");
-    
-    // 定位到最后一行并清除
-    printf("\033[%d;1H\033[K", orig_lines);
+    int col = put_text(frame, 0, 0, "输入: ", COLOR_INPUT);
+    col = put_text(frame, 0, col, im_state.display, COLOR_INPUT);
+    // 填充剩余空间
+    for (; col < frame.cols - 10; col++) frame.cells[col] = {{' ', 0, 0, 0}, 1, COLOR_INPUT};
+    put_text(frame, 0, col, im_state.is_chinese ? "[中文]" : "[英文]", COLOR_STATUS);
     
-    // 绘制候选词
     if (im_state.is_chinese && !im_state.candidates.empty()) {
         int start = im_state.page_start;
         int end = std::min(start + im_state.page_size, (int)im_state.candidates.size());
-        
+        col = 0;
         for (int i = start; i < end; i++) {
             // 高亮显示选中的候选词
-            if (i == im_state.selected_index) {
-                printf(SELECTED_COLOR);
-            } else {
-                printf(CANDIDATE_COLOR);
-            }
-            
+            uint8_t color = i == im_state.selected_index ? COLOR_SELECTED : COLOR_CANDIDATE;
             // 显示候选词和编号
-            int display_num = (i - start + 1) % 10;
-            char num_char = (display_num == 0) ? '0' : ('0' + display_num);
-            printf("%c. %s ", num_char, im_state.candidates[i].c_str());
+            char number[] = {static_cast<char>('0' + (i - start + 1) % 10), '.', ' ', 0};
+            col = put_text(frame, 1, col, number, color);
+            col = put_text(frame, 1, col, im_state.candidates[i].text, color);
+            col = put_text(frame, 1, col, " ", color);
         }
-        printf(RESET_COLOR);
+    }
+}
+
+// 输出 frame 中与 previous 不同的单元格（previous 为空时输出整帧），top 为第一行的行号
+// 相隔不到4格的变化合成一段，避免频繁移动光标；到行尾都是空白时用 \033[K 清除
+void diff_frame(const ImeFrame& frame, const ImeFrame* previous, int top, std::string& out) {
+    const int GAP = 4;
+    int color = -1;
+    auto set_color = [&](int c) {
+        if (c != color) out += CELL_COLORS[c];
+        color = c;
+    };
+    char move[32];
+    for (int row = 0; row < IME_ROWS; row++) {
+        const Cell* now = &frame.cells[row * frame.cols];
+        const Cell* old = previous ? &previous->cells[row * frame.cols] : nullptr;
+        int blank = frame.cols;  // 从这一列到行尾都是空白
+        while (blank > 0 && now[blank - 1] == BLANK_CELL) blank--;
+        int col = 0;
+        while (col < frame.cols) {
+            if (old && now[col] == old[col]) {
+                col++;
+                continue;
+            }
+            int start = col > 0 && now[col].width == 0 ? col - 1 : col;
+            int end = col, same = 0;
+            for (; end < frame.cols && same < GAP; end++) same = old && now[end] == old[end] ? same + 1 : 0;
+            end -= same;
+            snprintf(move, sizeof(move), "\033[%d;%dH", top + row, start + 1);
+            out += move;
+            for (col = start; col < end && col < blank; col++) {
+                if (now[col].width == 0) continue;
+                set_color(now[col].color);
+                out.append(now[col].glyph, strnlen(now[col].glyph, sizeof(now[col].glyph)));
+            }
+            if (end > blank) {
+                set_color(COLOR_NONE);
+                out += "\033[K";
+                break;
+            }
+            col = end;
+        }
+    }
+    if (color > COLOR_NONE) out += RESET_COLOR;
+}
+
+void draw_ime() {
+    compose_ime(ime_frame);
+    bool full = !screen_frame.valid || screen_frame.cols != ime_frame.cols;
+    frame_output.clear();
+    diff_frame(ime_frame, full ? nullptr : &screen_frame, orig_lines - 1, frame_output);
+    if (!frame_output.empty()) {
+        // 保存和恢复光标位置（DECSC/DECRC），子进程的光标不受影响
+        frame_output.insert(0, "\0337");
+        frame_output += "\0338";
     }
     
-    // 恢复光标位置
-    printf("\0338"); // DECRC - 恢复光标位置
-    fflush(stdout);
+    if (draw_stats.enabled) {
+        static std::string full_output;
+        full_output.clear();
+        diff_frame(ime_frame, nullptr, orig_lines - 1, full_output);
+        draw_stats.frames++;
+        draw_stats.bytes += frame_output.size();
+        draw_stats.max_bytes = std::max(draw_stats.max_bytes, frame_output.size());
+        draw_stats.full_bytes += full_output.size() + 4;
+    }
+    
+    bool written = write_all(STDOUT_FILENO, frame_output.data(), frame_output.size());
+    std::swap(ime_frame, screen_frame);
+    screen_frame.valid = written;
 }
 
-// 处理按键输入
+// 处理中文模式下的一个按键（Ctrl+Z 在两种模式下都交给这里）
 void handle_input(char ch) {
     // Ctrl+Z 切换中英文模式
     if (ch == 0x1A) {
         im_state.is_chinese = !im_state.is_chinese;
         im_state.input_buffer.clear();
-        im_state.candidates.clear();
+        update_candidates();
         draw_ime();
         return;
     }
     
-    if (!im_state.is_chinese) {
-        // 英文模式：直接传递所有输入
-        char c = ch;
-        send_to_child(std::string(&c, 1));
-        return;
-    }
-    
     // 中文模式处理
     if (ch == '\r' || ch == '\n') {
         // 回车键：提交当前输入缓冲区作为英文输入
         if (!im_state.input_buffer.empty()) {
             send_to_child(im_state.input_buffer);
             im_state.input_buffer.clear();
-            im_state.candidates.clear();
+            update_candidates();
         }
         // 发送回车
         send_to_child("\r");
@@ -206,10 +1376,7 @@ void handle_input(char ch) {
     } else if (ch == ' ') {
         // 空格键选择当前候选词
         if (!im_state.candidates.empty()) {
-            send_to_child(im_state.candidates[im_state.selected_index]);
-            im_state.input_buffer.clear();
-            im_state.candidates.clear();
-            draw_ime();
+            commit_candidate(im_state.selected_index);
         } else {
             send_to_child(" ");
         }
@@ -218,72 +1385,267 @@ void handle_input(char ch) {
         int idx = ch - '1';
         int actual_index = im_state.page_start + idx;
         if (actual_index < im_state.candidates.size()) {
-            send_to_child(im_state.candidates[actual_index]);
-            im_state.input_buffer.clear();
-            im_state.candidates.clear();
-            draw_ime();
+            commit_candidate(actual_index);
         }
     } else if (ch == '0') {
         // 0选择第10个候选词
         int actual_index = im_state.page_start + 9;
         if (actual_index < im_state.candidates.size()) {
-            send_to_child(im_state.candidates[actual_index]);
-            im_state.input_buffer.clear();
-            im_state.candidates.clear();
-            draw_ime();
+            commit_candidate(actual_index);
         }
-    } else if (ch == 0x1B) { // ESC
-        // 处理方向键
-        char seq[3];
-        if (read(STDIN_FILENO, &seq[0], 1) != 1) return;
-        if (read(STDIN_FILENO, &seq[1], 1) != 1) return;
-        
-        if (seq[0] == '[') {
-            switch (seq[1]) {
-                case 'A': // 上箭头
-                    if (im_state.page_start >= im_state.page_size) {
-                        im_state.page_start -= im_state.page_size;
-                        im_state.selected_index = im_state.page_start;
-                        draw_ime();
-                    }
-                    break;
-                case 'B': // 下箭头
-                    if (im_state.page_start + im_state.page_size < im_state.candidates.size()) {
-                        im_state.page_start += im_state.page_size;
-                        im_state.selected_index = im_state.page_start;
-                        draw_ime();
-                    }
-                    break;
-                case 'C': // 右箭头
-                    if (im_state.selected_index < im_state.candidates.size() - 1) {
-                        im_state.selected_index++;
-                        if (im_state.selected_index >= im_state.page_start + im_state.page_size) {
-                            im_state.page_start += im_state.page_size;
-                        }
-                        draw_ime();
-                    }
-                    break;
-                case 'D': // 左箭头
-                    if (im_state.selected_index > 0) {
-                        im_state.selected_index--;
-                        if (im_state.selected_index < im_state.page_start) {
-                            im_state.page_start -= im_state.page_size;
-                        }
-                        draw_ime();
-                    }
-                    break;
-            }
-        }
-    } else if (isalpha(ch)) {
-        // 字母键添加到输入缓冲区
+    } else if (ch == '\'' && !im_state.input_buffer.empty() && im_state.input_buffer.back() != '\'') {
+        // 单引号分隔音节（如 xi'an）
         im_state.input_buffer += ch;
         update_candidates();
         draw_ime();
+    } else if (isalpha(ch)) {
+        // 字母键添加到输入缓冲区
+        if (im_state.input_buffer.size() < MAX_INPUT) {
+            im_state.input_buffer += ch;
+            update_candidates();
+        }
+        draw_ime();
     } else {
         // 其他字符直接发送
-        char c = ch;
-        send_to_child(std::string(&c, 1));
+        send_to_child(std::string_view(&ch, 1));
+    }
+}
+
+// 中文模式下的方向键（ESC [ 或 ESC O 序列的结束字符）
+void handle_arrow(char key) {
+    switch (key) {
+        case 'A': // 上箭头
+            if (im_state.page_start >= im_state.page_size) {
+                im_state.page_start -= im_state.page_size;
+                im_state.selected_index = im_state.page_start;
+                draw_ime();
+            }
+            break;
+        case 'B': // 下箭头
+            if (im_state.page_start + im_state.page_size < im_state.candidates.size()) {
+                im_state.page_start += im_state.page_size;
+                im_state.selected_index = im_state.page_start;
+                draw_ime();
+            }
+            break;
+        case 'C': // 右箭头
+            if (im_state.selected_index < im_state.candidates.size() - 1) {
+                im_state.selected_index++;
+                if (im_state.selected_index >= im_state.page_start + im_state.page_size) {
+                    im_state.page_start += im_state.page_size;
+                }
+                draw_ime();
+            }
+            break;
+        case 'D': // 左箭头
+            if (im_state.selected_index > 0) {
+                im_state.selected_index--;
+                if (im_state.selected_index < im_state.page_start) {
+                    im_state.page_start -= im_state.page_size;
+                }
+                draw_ime();
+            }
+            break;
+    }
+}
+
+// 中文模式下单独按 ESC：清空正在输入的拼音，没有拼音时传给子进程
+void handle_escape() {
+    if (im_state.input_buffer.empty()) {
+        send_to_child("\033");
+        return;
+    }
+    im_state.input_buffer.clear();
+    update_candidates();
+    draw_ime();
+}
+
+// 中文模式下的 ESC 序列：正在输入拼音时方向键用来选择候选，其余忽略；没有拼音时整个序列传给子进程（方向键、功能键、Alt 组合键等）
+void handle_sequence(const std::string& sequence) {
+    if (im_state.input_buffer.empty()) {
+        send_to_child(sequence);
+        return;
     }
+    char last = sequence.back();
+    if (sequence.size() >= 3 && (sequence[1] == '[' || sequence[1] == 'O') && last >= 'A' && last <= 'D') {
+        handle_arrow(last);
+    }
+}
+
+// 键盘输入解码：按（状态，字节类别）查表得到下一个状态和动作，状态跨读入保留
+// ESC 之后 ESC_TIMEOUT_MS 内没有后续字节时当作单独按下的 ESC 键，主循环用 timerfd 计时
+// 括号粘贴（ESC [200~ 和 ESC [201~ 之间）的内容不经过输入法，连同标记整段转发给子进程
+// 英文模式下所有字节（包括 ESC 序列）照原样立即转发，解码只用来识别括号粘贴，粘贴内容中的 Ctrl+Z 不切换模式
+enum InputState : uint8_t { INPUT_GROUND, INPUT_ESCAPE, INPUT_CSI, INPUT_SS3, INPUT_PASTE };
+
+enum InputAction : uint8_t {
+    ACTION_KEY,       // 普通按键
+    ACTION_START,     // ESC：开始新的序列（丢掉没完成的序列）
+    ACTION_RESTART,   // ESC 后又是 ESC：前一个是单独的 ESC 键
+    ACTION_COLLECT,   // 序列中间的字节
+    ACTION_DISPATCH,  // 序列的最后一个字节
+    ACTION_ABORT,     // 序列中出现控制字符：丢掉序列，这个字节按普通按键处理
+};
+
+enum ByteClass : uint8_t {
+    BYTE_CONTROL,       // 0x00-0x1F（ESC 除外）
+    BYTE_ESC,
+    BYTE_INTERMEDIATE,  // 0x20-0x2F
+    BYTE_PARAM,         // 0x30-0x3F
+    BYTE_CSI,           // '['
+    BYTE_SS3,           // 'O'
+    BYTE_FINAL,         // 0x40-0x7E 中的其余字符
+    BYTE_OTHER,         // DEL 和非 ASCII 字节
+    BYTE_CLASSES
+};
+
+struct InputTransition {
+    InputState next;
+    InputAction action;
+};
+
+const InputTransition INPUT_TABLE[INPUT_PASTE][BYTE_CLASSES] = {
+    // INPUT_GROUND
+    {{INPUT_GROUND, ACTION_KEY}, {INPUT_ESCAPE, ACTION_START}, {INPUT_GROUND, ACTION_KEY}, {INPUT_GROUND, ACTION_KEY},
+     {INPUT_GROUND, ACTION_KEY}, {INPUT_GROUND, ACTION_KEY}, {INPUT_GROUND, ACTION_KEY}, {INPUT_GROUND, ACTION_KEY}},
+    // INPUT_ESCAPE：ESC [ 和 ESC O 开始 CSI/SS3 序列，其余为 Alt 组合键
+    {{INPUT_GROUND, ACTION_DISPATCH}, {INPUT_ESCAPE, ACTION_RESTART}, {INPUT_GROUND, ACTION_DISPATCH}, {INPUT_GROUND, ACTION_DISPATCH},
+     {INPUT_CSI, ACTION_COLLECT}, {INPUT_SS3, ACTION_COLLECT}, {INPUT_GROUND, ACTION_DISPATCH}, {INPUT_GROUND, ACTION_DISPATCH}},
+    // INPUT_CSI：参数和中间字节之后是结束字符
+    {{INPUT_GROUND, ACTION_ABORT}, {INPUT_ESCAPE, ACTION_START}, {INPUT_CSI, ACTION_COLLECT}, {INPUT_CSI, ACTION_COLLECT},
+     {INPUT_GROUND, ACTION_DISPATCH}, {INPUT_GROUND, ACTION_DISPATCH}, {INPUT_GROUND, ACTION_DISPATCH}, {INPUT_GROUND, ACTION_ABORT}},
+    // INPUT_SS3：下一个字符就是结束字符（可能带修饰键参数）
+    {{INPUT_GROUND, ACTION_ABORT}, {INPUT_ESCAPE, ACTION_START}, {INPUT_SS3, ACTION_COLLECT}, {INPUT_SS3, ACTION_COLLECT},
+     {INPUT_GROUND, ACTION_DISPATCH}, {INPUT_GROUND, ACTION_DISPATCH}, {INPUT_GROUND, ACTION_DISPATCH}, {INPUT_GROUND, ACTION_ABORT}},
+};
+
+ByteClass byte_class(unsigned char c) {
+    if (c == 0x1B) return BYTE_ESC;
+    if (c < 0x20) return BYTE_CONTROL;
+    if (c < 0x30) return BYTE_INTERMEDIATE;
+    if (c < 0x40) return BYTE_PARAM;
+    if (c == '[') return BYTE_CSI;
+    if (c == 'O') return BYTE_SS3;
+    if (c < 0x7F) return BYTE_FINAL;
+    return BYTE_OTHER;
+}
+
+const char PASTE_BEGIN[] = "\033[200~";
+const char PASTE_END[] = "\033[201~";
+const int ESC_TIMEOUT_MS = 50;
+const size_t MAX_SEQUENCE = 32;   // 更长的序列丢掉
+
+struct InputDecoder {
+    InputState state = INPUT_GROUND;
+    std::string sequence;        // 正在解析的 ESC 序列
+    size_t paste_matched = 0;    // 粘贴内容末尾已匹配的结束标记长度
+};
+
+InputDecoder input_decoder;
+
+// ESC 序列是否还没完成
+bool input_pending() {
+    InputState state = input_decoder.state;
+    return state == INPUT_ESCAPE || state == INPUT_CSI || state == INPUT_SS3;
+}
+
+// 粘贴内容：找到结束标记为止的字节整段转发（标记可能被分在两次读入中），返回用掉的字节数
+size_t paste_input(const char* data, size_t size) {
+    InputDecoder& decoder = input_decoder;
+    const size_t end_length = sizeof(PASTE_END) - 1;
+    size_t i = 0;
+    while (i < size && decoder.state == INPUT_PASTE) {
+        if (decoder.paste_matched == 0) {
+            const char* esc = static_cast<const char*>(memchr(data + i, 0x1B, size - i));
+            if (!esc) {
+                i = size;
+                break;
+            }
+            i = esc - data + 1;
+            decoder.paste_matched = 1;
+        } else if (data[i] == PASTE_END[decoder.paste_matched]) {
+            i++;
+            if (++decoder.paste_matched == end_length) {
+                decoder.state = INPUT_GROUND;
+                decoder.paste_matched = 0;
+            }
+        } else {
+            decoder.paste_matched = 0;  // 重新检查这个字节
+        }
+    }
+    send_to_child(std::string_view(data, i));
+    return i;
+}
+
+// 处理一次读入的整段键盘输入
+void process_input(const char* data, size_t size) {
+    InputDecoder& decoder = input_decoder;
+    size_t i = 0;
+    while (i < size) {
+        if (decoder.state == INPUT_PASTE) {
+            i += paste_input(data + i, size - i);
+            continue;
+        }
+        bool english = !im_state.is_chinese;
+        if (english && decoder.state == INPUT_GROUND) {
+            // 英文模式：到下一个 Ctrl+Z 或 ESC 为止的字节整段转发
+            size_t end = i;
+            while (end < size && data[end] != 0x1A && data[end] != 0x1B) end++;
+            send_to_child(std::string_view(data + i, end - i));
+            i = end;
+            if (i == size) break;
+        }
+        
+        unsigned char ch = data[i];
+        std::string_view byte(data + i, 1);
+        i++;
+        const InputTransition& transition = INPUT_TABLE[decoder.state][byte_class(ch)];
+        decoder.state = transition.next;
+        if (english && ch != 0x1A) send_to_child(byte);
+        switch (transition.action) {
+            case ACTION_ABORT:
+                decoder.sequence.clear();
+                if (!english || ch == 0x1A) handle_input(ch);
+                break;
+            case ACTION_KEY:
+                if (!english || ch == 0x1A) handle_input(ch);
+                break;
+            case ACTION_RESTART:
+                if (!english) handle_escape();
+                decoder.sequence.assign(byte);
+                break;
+            case ACTION_START:
+                decoder.sequence.assign(byte);
+                break;
+            case ACTION_COLLECT:
+                decoder.sequence += byte;
+                if (decoder.sequence.size() >= MAX_SEQUENCE) {
+                    decoder.state = INPUT_GROUND;
+                    decoder.sequence.clear();
+                }
+                break;
+            case ACTION_DISPATCH:
+                decoder.sequence += byte;
+                if (decoder.sequence == PASTE_BEGIN) {
+                    decoder.state = INPUT_PASTE;
+                    if (!english) send_to_child(decoder.sequence);
+                } else if (!english) {
+                    handle_sequence(decoder.sequence);
+                }
+                decoder.sequence.clear();
+                break;
+        }
+    }
+    flush_child_queue();
+}
+
+// 序列等不到后续字节：单独的 ESC 键，或者丢掉没完成的序列（英文模式下都已经转发过了）
+void input_timeout() {
+    InputDecoder& decoder = input_decoder;
+    if (decoder.state == INPUT_ESCAPE && im_state.is_chinese) handle_escape();
+    decoder.state = INPUT_GROUND;
+    decoder.sequence.clear();
+    flush_child_queue();
 }
 
 // 创建伪终端并运行子进程
@@ -311,6 +1673,8 @@ void run_child_process(char* argv[]) {
         child_ws.ws_row -= 2;
         ioctl(STDIN_FILENO, TIOCSWINSZ, &child_ws);
         
+        // 父进程屏蔽了交给 signalfd 的信号，子进程恢复
+        sigprocmask(SIG_UNBLOCK, &event_signals, NULL);
         execvp(argv[0], argv);
         perror("execvp");
         exit(1);
@@ -333,8 +1697,8 @@ void resize_terminal() {
     ioctl(pty_master, TIOCSWINSZ, &ws);
     
     // 清除并重绘输入法区域
+    screen_frame.valid = false;
     draw_ime();
-    resize_occurred = false;
 }
 
 // 清屏并重绘输入法
@@ -343,6 +1707,8 @@ void reset_display() {
     printf("\033[2J");
     // 移动光标到左上角
     printf("\033[H");
+    fflush(stdout);
+    screen_frame.valid = false;
     
     // 通知子进程重绘
     struct winsize ws;
@@ -354,25 +1720,186 @@ void reset_display() {
     draw_ime();
 }
 
+// 事件循环：epoll 等待所有事件源，没有事件时一直睡着，不定时醒来
+// 信号经 signalfd、ESC 超时经 timerfd 也变成可读的 fd；以后要加的 fd（重新载入词库、进程间通信等）注册一个处理函数即可
+struct EventSource {
+    int fd = -1;
+    uint32_t events = 0;                 // 当前关注的事件
+    void (*handler)(uint32_t events);    // fd 就绪时调用，参数为就绪的事件
+};
+
+const int EXIT_DRAIN_MS = 100;    // 子进程退出后最多再等这么久读完伪终端中的输出
+
+int epoll_fd = -1;
+bool running = true;
+bool child_reaped = false;                        // 子进程已退出，只等剩余输出
+std::chrono::steady_clock::time_point exit_deadline;
+EventSource keyboard_source, child_source, signal_source, timer_source;
+
+// 把 fd 加入 epoll
+bool watch_fd(EventSource& source, int fd, uint32_t events, void (*handler)(uint32_t)) {
+    source.fd = fd;
+    source.events = events;
+    source.handler = handler;
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.ptr = &source;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+// 改变关注的事件，没变时不做系统调用
+void set_events(EventSource& source, uint32_t events) {
+    if (source.fd < 0 || source.events == events) return;
+    source.events = events;
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.ptr = &source;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, source.fd, &event);
+}
+
+// 不再关注这个 fd（fd 本身不关闭）
+void unwatch_fd(EventSource& source) {
+    if (source.fd < 0) return;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, source.fd, NULL);
+    source.fd = -1;
+}
+
+// 有没完成的 ESC 序列时启动 ESC_TIMEOUT_MS 的单次定时器，否则停掉
+void arm_input_timer() {
+    struct itimerspec spec = {};
+    if (input_pending()) spec.it_value.tv_nsec = ESC_TIMEOUT_MS * 1000000L;
+    timerfd_settime(timer_source.fd, 0, &spec, NULL);
+}
+
+// 键盘输入：一次读入所有已到达的输入
+void on_keyboard(uint32_t) {
+    static char input[65536];
+    int n = read(STDIN_FILENO, input, sizeof(input));
+    if (n > 0) {
+        process_input(input, n);
+        arm_input_timer();
+    } else if (n == 0 || errno != EAGAIN) {
+        unwatch_fd(keyboard_source);  // 终端关闭，不再读
+    }
+}
+
+// 子进程输出，以及伪终端有空间继续写积压的输入
+void on_child(uint32_t events) {
+    if (events & EPOLLOUT) {
+        flush_child_queue();
+    }
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        char buffer[4096];
+        int n = read(pty_master, buffer, sizeof(buffer));
+        if (n > 0) {
+            // 直接输出到终端，可能覆盖了输入法界面
+            write(STDOUT_FILENO, buffer, n);
+            screen_frame.valid = false;
+        } else if (n == 0 || (n < 0 && errno != EAGAIN)) {
+            // 子进程已退出
+            running = false;
+        }
+    }
+}
+
+// SIGWINCH：调整大小；SIGCHLD：子进程退出后继续经 EPOLLIN 读剩余输出，读到结束或 EXIT_DRAIN_MS 后退出
+// （停止、继续也会发 SIGCHLD，不算退出；孙进程仍开着伪终端时读不到结束，靠截止时间退出）
+void on_signal(uint32_t) {
+    struct signalfd_siginfo info;
+    while (read(signal_source.fd, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo == SIGWINCH) {
+            resize_terminal();
+        } else if (info.ssi_signo == SIGCHLD && waitpid(child_pid, &child_status, WNOHANG) == child_pid) {
+            child_reaped = true;
+            exit_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(EXIT_DRAIN_MS);
+        }
+    }
+}
+
+// ESC 序列等后续字节超时
+void on_input_timer(uint32_t) {
+    uint64_t expirations;
+    if (read(timer_source.fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return;
+    if (input_pending()) input_timeout();
+}
+
+// 建立 epoll 和各事件源
+bool setup_event_loop() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int signal_fd = signalfd(-1, &event_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epoll_fd < 0 || signal_fd < 0 || timer_fd < 0) return false;
+    return watch_fd(keyboard_source, STDIN_FILENO, EPOLLIN, on_keyboard) &&
+           watch_fd(child_source, pty_master, EPOLLIN, on_child) &&
+           watch_fd(signal_source, signal_fd, EPOLLIN, on_signal) &&
+           watch_fd(timer_source, timer_fd, EPOLLIN, on_input_timer);
+}
+
+// 主事件循环
+void run_event_loop() {
+    struct epoll_event events[8];
+    while (running) {
+        // 积压太多时不再读键盘，让终端那边等着；有积压时等伪终端可写
+        set_events(keyboard_source, child_queue.size() < CHILD_QUEUE_LIMIT ? static_cast<uint32_t>(EPOLLIN) : 0u);
+        set_events(child_source, EPOLLIN | (child_queue.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT)));
+        // 平时不设超时；子进程退出后最多等到截止时间
+        int timeout = -1;
+        if (child_reaped) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(exit_deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) break;
+            timeout = static_cast<int>(left.count()) + 1;
+        }
+        int count = epoll_wait(epoll_fd, events, 8, timeout);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < count && running; i++) {
+            EventSource* source = static_cast<EventSource*>(events[i].data.ptr);
+            if (source->fd >= 0) source->handler(events[i].events);
+        }
+    }
+}
+
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <command> [args...]\n", argv[0]);
+    if (argc >= 2 && strcmp(argv[1], "--compile") == 0) {
+        return compile_command(argc >= 3 ? argv[2] : "srf.conf");
+    }
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+        const char* config = argc >= 3 ? argv[2] : "srf.conf";
+        return bench_command(config, argc > 3 ? argc - 3 : 0, argv + 3);
+    }
+    int command = 1;
+    if (argc >= 2 && strcmp(argv[1], "--stats") == 0) {
+        draw_stats.enabled = true;
+        command = 2;
+    }
+    if (argc <= command) {
+        fprintf(stderr, "Usage: %s [--stats] <command> [args...]\n", argv[0]);
+        fprintf(stderr, "       %s --compile [srf.conf]\n", argv[0]);
+        fprintf(stderr, "       %s --bench [srf.conf] [pinyin...]\n", argv[0]);
         return 1;
     }
     
     // 初始化输入法状态
     im_state.is_chinese = true;
     im_state.page_size = 8; // 根据终端宽度调整
+    im_state.sentences.resize(SENTENCES);
+    im_state.sentence_words.resize(SENTENCES);
     
-    // 加载拼音字典
-    load_config("srf.conf");
+    // 加载拼音字典和用户词频
+    load_dictionary("srf.conf");
+    load_user_log("srf.conf");
     
     // 获取原始终端设置
     tcgetattr(STDIN_FILENO, &orig_termios);
     
-    // 设置信号处理
-    signal(SIGWINCH, handle_sigwinch);
-    signal(SIGCHLD, handle_sigchld);
+    // 设置信号处理：SIGWINCH、SIGCHLD 屏蔽后由事件循环从 signalfd 读出（之后创建的后台线程继承屏蔽）
+    sigemptyset(&event_signals);
+    sigaddset(&event_signals, SIGWINCH);
+    sigaddset(&event_signals, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &event_signals, NULL);
     signal(SIGINT, cleanup_exit);
     signal(SIGTERM, cleanup_exit);
     signal(SIGHUP, cleanup_exit);
@@ -395,7 +1922,7 @@ int main(int argc, char* argv[]) {
     fflush(stdout);
     
     // 运行子进程
-    run_child_process(&argv[1]);
+    run_child_process(&argv[command]);
     
     // 设置非阻塞IO
     fcntl(pty_master, F_SETFL, O_NONBLOCK);
@@ -405,68 +1932,24 @@ int main(int argc, char* argv[]) {
     reset_display();
     
     // 主事件循环
-    struct pollfd fds[2];
-    fds[0].fd = STDIN_FILENO;
-    fds[0].events = POLLIN;
-    fds[1].fd = pty_master;
-    fds[1].events = POLLIN;
-    
-    char buffer[4096];
-    int n;
-    
-    while (true) {
-        if (child_exited) {
-            // 子进程已退出，读取剩余输出
-            while ((n = read(pty_master, buffer, sizeof(buffer)))) {
-                if (n > 0) {
-                    write(STDOUT_FILENO, buffer, n);
-                } else if (n == 0 || (n < 0 && errno != EAGAIN)) {
-                    break;
-                }
-            }
-            break;
-        }
-        
-        if (resize_occurred) {
-            resize_terminal();
-        }
-        
-        int ret = poll(fds, 2, 100); // 100ms超时
-        
-        if (ret < 0) {
-            if (errno == EINTR) continue; // 信号中断
-            perror("poll");
-            break;
-        }
-        
-        // 处理键盘输入
-        if (fds[0].revents & POLLIN) {
-            char ch;
-            if (read(STDIN_FILENO, &ch, 1) == 1) {
-                handle_input(ch);
-            }
-        }
-        
-        // 处理子进程输出
-        if (fds[1].revents & POLLIN) {
-            n = read(pty_master, buffer, sizeof(buffer));
-            if (n > 0) {
-                // 直接输出到终端
-                write(STDOUT_FILENO, buffer, n);
-            } else if (n == 0 || (n < 0 && errno != EAGAIN)) {
-                // 子进程已退出
-                break;
-            }
-        }
+    if (!setup_event_loop()) {
+        perror("epoll");
+    } else {
+        run_event_loop();
     }
     
     // 清理资源
     restore_terminal();
     close(pty_master);
+    close_user_log();
+    if (draw_stats.enabled && draw_stats.frames) {
+        fprintf(stderr, "draw_ime: %zu frames, %.1f bytes/frame (max %zu), full redraw %.1f bytes/frame\n",
+                draw_stats.frames, (double)draw_stats.bytes / draw_stats.frames, draw_stats.max_bytes,
+                (double)draw_stats.full_bytes / draw_stats.frames);
+    }
     
-    // 等待子进程结束
-    int status;
-    waitpid(child_pid, &status, 0);
+    // 等待子进程结束（SIGCHLD 时已经回收的不再等）
+    if (child_status < 0) waitpid(child_pid, &child_status, 0);
     
     return 0;
 }
\ No newline at end of file